@@ -3,6 +3,7 @@
 #include <initializer_list>
 #include <tuple>
 #include <map>
+#include <optional>
 #include <set>
 #include <vector>
 #include <string>
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+class Rng
+{
+public:
+  using result_type = uint32_t;
+  using State = std::array<uint32_t, 4>;
+
+  Rng(uint64_t seed = 0)
+  {
+    this->seed(seed);
+  }
+
+  void seed(uint64_t seed)
+  {
+    for(auto &word : s_)
+    {
+      seed += 0x9e3779b97f4a7c15;
+      auto z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      word = uint32_t(z ^ (z >> 31));
+    }
+  }
+
+  uint32_t operator()()
+  {
+    auto result = rotl(s_[1] * 5, 7) * 9;
+    auto t = s_[1] << 9;
+
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 11);
+
+    return result;
+  }
+
+  uint32_t below(uint32_t n)
+  {
+    auto m = uint64_t((*this)()) * n;
+
+    if(uint32_t(m) < n)
+    {
+      auto threshold = -n % n;
+      while(uint32_t(m) < threshold)
+        m = uint64_t((*this)()) * n;
+    }
+
+    return m >> 32;
+  }
+
+  const State &state() const { return s_; }
+  void setState(const State &state) { s_ = state; }
+
+  static constexpr uint32_t min() { return 0; }
+  static constexpr uint32_t max() { return std::numeric_limits<uint32_t>::max(); }
+
+private:
+  static uint32_t rotl(uint32_t x, int k)
+  {
+    return (x << k) | (x >> (32 - k));
+  }
+
+  State s_;
+};
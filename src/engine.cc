@@ -0,0 +1,470 @@
+#include "engine.hh"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+  constexpr int32_t gravityFor(int difficulty)
+  {
+    constexpr int32_t G = ONEROW;
+    constexpr int32_t fastest[] = {G / 2, G, 2*G, 3*G, 4*G, 5*G, 8*G, 12*G, 16*G, 20*G};
+
+    return difficulty < 10
+         ? ONEROW * 20 / ((10 - difficulty) * TICKRATE)
+         : fastest[difficulty - 10];
+  }
+}
+
+const std::array<Shape, NSHAPES> g_shapes
+{{
+  Shape("00  "
+        "00  "
+        "    "
+        "    "),
+
+  Shape("0   "
+        "0   "
+        "0   "
+        "0   "),
+
+  Shape("000 "
+        " 0  "
+        "    "
+        "    "),
+
+  Shape(" 00 "
+        "00  "
+        "    "
+        "    "),
+
+  Shape("00  "
+        " 00 "
+        "    "
+        "    "),
+
+  Shape("0   "
+        "000 "
+        "    "
+        "    "),
+
+  Shape("  0 "
+        "000 "
+        "    "
+        "    ")
+}};
+
+std::optional<Randomizer> parseRandomizer(std::string_view name)
+{
+  if(name == "uniform")
+    return Randomizer::Uniform;
+  else if(name == "bag")
+    return Randomizer::Bag;
+  else
+    return {};
+}
+
+void PieceSource::start(uint64_t seed, Randomizer randomizer)
+{
+  rng_.seed(seed);
+  randomizer_ = randomizer;
+
+  std::iota(bag_.begin(), bag_.end(), 0);
+  bagPos_ = bag_.size();
+}
+
+PieceSource::Piece PieceSource::next()
+{
+  Piece piece;
+
+  piece.shape = nextShape();
+  piece.col = 1 + rng_.below(NCOLORS);
+  piece.v = rng_.below(4);
+
+  return piece;
+}
+
+PieceSource::State PieceSource::state() const
+{
+  return {rng_.state(), randomizer_, bag_, bagPos_};
+}
+
+void PieceSource::restore(const State &state)
+{
+  rng_.setState(state.rng);
+  randomizer_ = state.randomizer;
+  bag_ = state.bag;
+  bagPos_ = state.bagPos;
+}
+
+int PieceSource::nextShape()
+{
+  if(randomizer_ == Randomizer::Uniform)
+    return rng_.below(NSHAPES);
+
+  if(bagPos_ == bag_.size())
+  {
+    for(int i = bag_.size() - 1; i > 0; i--)
+      std::swap(bag_[i], bag_[rng_.below(i + 1)]);
+
+    bagPos_ = 0;
+  }
+
+  return bag_[bagPos_++];
+}
+
+void Engine::start(uint64_t seed, int difficulty, Randomizer randomizer)
+{
+  seed_ = seed;
+  pieces_.start(seed, randomizer);
+
+  std::fill(&rows_[0], &rows_[GAMEHEI], WALLROW);
+  std::fill(&rows_[GAMEHEI], &rows_[GAMEHEI + 4], FULLROW);
+  memset(cell_, 0, sizeof(cell_));
+  std::fill(&top_[0], &top_[GAMEWID], GAMEHEI);
+  std::fill(&dirty_[0], &dirty_[GAMEHEI], uint16_t(~WALLROW));
+
+  falling_ = {};
+  fallingNext_ = {};
+  cleared_ = {};
+
+  difficulty_ = difficulty;
+  gravity_ = gravityFor(difficulty_);
+  fall_ = 0;
+  resting_ = 0;
+  score_ = 0;
+  ticks_ = 0;
+
+  over_ = false;
+
+  spawn();
+  spawn();
+}
+
+Engine::Snapshot Engine::snapshot() const
+{
+  Snapshot snapshot;
+
+  snapshot.seed = seed_;
+  snapshot.difficulty = difficulty_;
+  snapshot.pieces = pieces_.state();
+  memcpy(snapshot.cell, cell_, sizeof(cell_));
+  snapshot.falling = falling_;
+  snapshot.fallingNext = fallingNext_;
+  snapshot.fall = fall_;
+  snapshot.resting = resting_;
+  snapshot.score = score_;
+  snapshot.ticks = ticks_;
+  snapshot.over = over_;
+
+  return snapshot;
+}
+
+void Engine::restore(const Snapshot &snapshot)
+{
+  seed_ = snapshot.seed;
+  pieces_.restore(snapshot.pieces);
+
+  memcpy(cell_, snapshot.cell, sizeof(cell_));
+  std::fill(&rows_[GAMEHEI], &rows_[GAMEHEI + 4], FULLROW);
+  std::fill(&top_[0], &top_[GAMEWID], GAMEHEI);
+  std::fill(&dirty_[0], &dirty_[GAMEHEI], uint16_t(~WALLROW));
+
+  for(int y = GAMEHEI - 1; y >= 0; y--)
+  {
+    rows_[y] = WALLROW;
+
+    for(int x = 0; x < GAMEWID; x++)
+      if(cell_[y][x])
+      {
+        rows_[y] |= 1 << x;
+        top_[x] = y;
+      }
+  }
+
+  falling_ = snapshot.falling;
+  fallingNext_ = snapshot.fallingNext;
+  cleared_ = {};
+
+  difficulty_ = snapshot.difficulty;
+  gravity_ = gravityFor(difficulty_);
+  fall_ = snapshot.fall;
+  resting_ = snapshot.resting;
+  score_ = snapshot.score;
+  ticks_ = snapshot.ticks;
+
+  over_ = snapshot.over;
+}
+
+void Engine::clearDirty()
+{
+  memset(dirty_, 0, sizeof(dirty_));
+}
+
+bool Engine::input(Input input)
+{
+  if(over_)
+    return false;
+
+  switch(input)
+  {
+    case Input::Left: return moveLeft();
+    case Input::Right: return moveRight();
+    case Input::Turn: return turn();
+    case Input::Skip: return skip();
+
+    default: return false;
+  }
+}
+
+bool Engine::tick()
+{
+  cleared_ = {};
+
+  if(over_)
+    return false;
+
+  ticks_++;
+
+  auto y = dropY(falling_);
+
+  resting_ = y == falling_.y ? resting_ + 1 : 0;
+
+  fall_ += gravity_;
+
+  if(fall_ < ONEROW)
+    return false;
+
+  auto distance = y - falling_.y;
+  auto rows = fall_ / ONEROW;
+
+  if(rows <= distance)
+  {
+    falling_.y += rows;
+    fall_ %= ONEROW;
+    return true;
+  }
+
+  if(distance > 0 || resting_ < LOCKDELAY)
+  {
+    falling_.y = y;
+    fall_ = ONEROW;
+    return distance > 0;
+  }
+
+  fall_ = 0;
+  resting_ = 0;
+
+  land();
+  reduce(falling_.y);
+  spawn();
+  if(collides())
+    over_ = true;
+
+  return true;
+}
+
+bool Engine::step(Input input)
+{
+  auto changed = this->input(input);
+  return tick() || changed;
+}
+
+int Engine::ticksUntilStep() const
+{
+  if(over_)
+    return std::numeric_limits<int>::max();
+
+  auto ticks = fall_ >= ONEROW ? 1 : (ONEROW - fall_ + gravity_ - 1) / gravity_;
+
+  if(dropY(falling_) == falling_.y)
+    ticks = std::max(ticks, LOCKDELAY - resting_);
+
+  return std::max(ticks, 1);
+}
+
+const bool (*Engine::getShape(const Falling &falling))[4]
+{
+  if(falling.shape)
+    return falling.shape->views[falling.v];
+  else
+    return nullptr;
+}
+
+const uint16_t *Engine::getRowMasks(const Falling &falling)
+{
+  return falling.shape->rowMasks[falling.v][falling.x];
+}
+
+void Engine::spawn()
+{
+  auto piece = pieces_.next();
+
+  falling_ = fallingNext_;
+
+  fallingNext_.shape = &g_shapes[piece.shape];
+  fallingNext_.col = piece.col;
+  fallingNext_.v = piece.v;
+  fallingNext_.y = 0;
+  fallingNext_.x = 4;
+}
+
+bool Engine::moveLeft()
+{
+  if(falling_.x > 0)
+  {
+    falling_.x--;
+    if(collides())
+      falling_.x++;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool Engine::moveRight()
+{
+  falling_.x++;
+  if(collides())
+    falling_.x--;
+
+  return true;
+}
+
+bool Engine::turn()
+{
+  falling_.v = (falling_.v + 1) % 4;
+  if(collides())
+    falling_.v = (falling_.v + 3) % 4;
+
+  return true;
+}
+
+bool Engine::skip()
+{
+  auto y = dropY(falling_);
+
+  if(y == falling_.y)
+  {
+    fall_ = 0;
+    resting_ = 0;
+    return false;
+  }
+  else
+  {
+    falling_.y = y;
+    fall_ = gravity_;
+    return true;
+  }
+}
+
+void Engine::land()
+{
+  auto shape = getShape(falling_);
+  auto masks = getRowMasks(falling_);
+
+  for(int yRel = 0; yRel < 4; yRel++)
+  {
+    rows_[falling_.y + yRel] |= masks[yRel];
+    dirty_[falling_.y + yRel] |= masks[yRel];
+
+    for(int xRel = 0; xRel < 4; xRel++)
+      if(shape[yRel][xRel])
+        cell_[falling_.y + yRel][falling_.x + xRel] = falling_.col;
+  }
+
+  auto tops = falling_.shape->tops[falling_.v];
+
+  for(int xRel = 0; xRel < 4; xRel++)
+    if(tops[xRel] >= 0)
+      top_[falling_.x + xRel] = std::min(top_[falling_.x + xRel], falling_.y + tops[xRel]);
+
+  falling_.shape = nullptr;
+}
+
+void Engine::reduce(int y)
+{
+  auto &c = cleared_;
+
+  for(int i = y; i < std::min(y + 4, GAMEHEI); i++)
+    if(rows_[i] == FULLROW)
+      c.rows[c.numRows++] = i;
+
+  if(c.numRows == 0)
+    return;
+
+  c.dscore = c.numRows * c.numRows + difficulty_;
+
+  score_ += c.dscore;
+
+  auto stackTop = *std::min_element(&top_[0], &top_[GAMEWID]);
+  auto dst = c.rows[c.numRows - 1];
+
+  for(int src = dst - 1; src >= stackTop; src--)
+  {
+    if(rows_[src] == FULLROW)
+      continue;
+
+    for(int x = 0; x < GAMEWID; x++)
+      if(cell_[dst][x] != cell_[src][x])
+        dirty_[dst] |= 1 << x;
+
+    rows_[dst] = rows_[src];
+    memcpy(cell_[dst], cell_[src], sizeof(cell_[dst]));
+    dst--;
+  }
+
+  for(; dst >= stackTop; dst--)
+  {
+    dirty_[dst] |= rows_[dst] & ~WALLROW;
+
+    rows_[dst] = WALLROW;
+    memset(cell_[dst], 0, sizeof(cell_[dst]));
+  }
+
+  for(int x = 0; x < GAMEWID; x++)
+    while(top_[x] < GAMEHEI && !(rows_[top_[x]] & (1 << x)))
+      top_[x]++;
+}
+
+bool Engine::collides() const
+{
+  return collides(falling_);
+}
+
+bool Engine::collides(const Falling &falling) const
+{
+  auto masks = getRowMasks(falling);
+  auto rows = &rows_[falling.y];
+
+  return (rows[0] & masks[0]) | (rows[1] & masks[1]) | (rows[2] & masks[2]) | (rows[3] & masks[3]);
+}
+
+int Engine::dropY(const Falling &falling) const
+{
+  auto bottoms = falling.shape->bottoms[falling.v];
+
+  int y = GAMEHEI;
+
+  for(int xRel = 0; xRel < 4; xRel++)
+    if(bottoms[xRel] >= 0)
+      y = std::min(y, top_[falling.x + xRel] - 1 - bottoms[xRel]);
+
+  if(y >= falling.y)
+    return y;
+
+  auto tmp = falling;
+
+  do tmp.y++; while(!collides(tmp));
+
+  return tmp.y - 1;
+}
+
+Engine::Falling Engine::ghost() const
+{
+  auto ghost = falling_;
+  ghost.y = dropY(falling_);
+  return ghost;
+}
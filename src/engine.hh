@@ -0,0 +1,238 @@
+#pragma once
+
+#include "common/rng.hh"
+#include <array>
+#include <optional>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+static constexpr auto NSHAPES = 7;
+static constexpr auto NCOLORS = 6;
+static constexpr auto GAMEWID = 10;
+static constexpr auto GAMEHEI = 20;
+static constexpr auto DIFFICULTYLIMIT = 20;
+
+static constexpr auto TICKRATE = 60;
+static constexpr auto ONEROW = 1 << 16;
+static constexpr auto LOCKDELAY = 3;
+
+static constexpr uint16_t WALLROW = uint16_t(~0u << GAMEWID);
+static constexpr uint16_t FULLROW = uint16_t(~0u);
+
+struct Shape
+{
+  Shape(std::string_view input)
+  {
+    bool view[4][4];
+
+    for(int y = 0; y < 4; y++)
+      for(int x = 0; x < 4; x++)
+        view[y][x] = input[4*y + x] != ' ';
+
+    for(int v = 0; v < 4; v++)
+    {
+      int upmostY = 4, leftmostX = 4;
+
+      for(int y = 0; y < 4; y++)
+        for(int x = 0; x < 4; x++)
+          if(view[y][x])
+          {
+            if(y < upmostY)
+              upmostY = y;
+            if(x < leftmostX)
+              leftmostX = x;
+          }
+
+      memcpy(&views[v][0][0],
+             &view[upmostY][leftmostX],
+             &view[4][0] - &view[upmostY][leftmostX]);
+
+      for(int y = 0; y < 4; y++)
+        for(int x = 0; x < 4; x++)
+          view[3-x][y] = views[v][y][x];
+    }
+
+    for(int v = 0; v < 4; v++)
+      for(int x = 0; x <= GAMEWID; x++)
+        for(int yRel = 0; yRel < 4; yRel++)
+          for(int xRel = 0; xRel < 4; xRel++)
+            if(views[v][yRel][xRel])
+              rowMasks[v][x][yRel] |= 1 << (x + xRel);
+
+    for(int v = 0; v < 4; v++)
+      for(int xRel = 0; xRel < 4; xRel++)
+      {
+        tops[v][xRel] = -1;
+        bottoms[v][xRel] = -1;
+
+        for(int yRel = 0; yRel < 4; yRel++)
+          if(views[v][yRel][xRel])
+          {
+            if(tops[v][xRel] < 0)
+              tops[v][xRel] = yRel;
+            bottoms[v][xRel] = yRel;
+          }
+      }
+  }
+
+  bool views[4][4][4] = {};
+  uint16_t rowMasks[4][GAMEWID + 1][4] = {};
+  int8_t tops[4][4], bottoms[4][4];
+};
+
+extern const std::array<Shape, NSHAPES> g_shapes;
+
+enum class Randomizer : uint8_t
+{
+  Uniform,
+  Bag
+};
+
+std::optional<Randomizer> parseRandomizer(std::string_view name);
+
+class PieceSource
+{
+public:
+  struct Piece
+  {
+    int shape, col, v;
+  };
+
+  struct State
+  {
+    Rng::State rng;
+    Randomizer randomizer;
+    std::array<uint8_t, NSHAPES> bag;
+    int bagPos;
+  };
+
+  void start(uint64_t seed, Randomizer randomizer);
+
+  Piece next();
+
+  State state() const;
+  void restore(const State &state);
+
+  Randomizer randomizer() const { return randomizer_; }
+
+private:
+  int nextShape();
+
+private:
+  Rng rng_;
+  Randomizer randomizer_;
+
+  std::array<uint8_t, NSHAPES> bag_;
+  int bagPos_;
+};
+
+enum class Input : uint8_t
+{
+  None,
+  Left,
+  Right,
+  Turn,
+  Skip
+};
+
+class Engine
+{
+public:
+  struct Falling
+  {
+    const Shape *shape;
+    int col, v, y, x;
+  };
+
+  struct Clear
+  {
+    int numRows;
+    int rows[4];
+    int dscore;
+  };
+
+  struct Snapshot
+  {
+    uint64_t seed;
+    int difficulty;
+    PieceSource::State pieces;
+    uint8_t cell[GAMEHEI][GAMEWID];
+    Falling falling, fallingNext;
+    int32_t fall;
+    int resting;
+    int score;
+    uint64_t ticks;
+    bool over;
+  };
+
+  void start(uint64_t seed, int difficulty, Randomizer randomizer = Randomizer::Uniform);
+
+  Snapshot snapshot() const;
+  void restore(const Snapshot &snapshot);
+
+  bool input(Input input);
+  bool tick();
+  bool step(Input input);
+
+  int ticksUntilStep() const;
+
+  bool over() const { return over_; }
+
+  uint8_t cell(int y, int x) const { return cell_[y][x]; }
+
+  uint16_t dirty(int y) const { return dirty_[y]; }
+  void clearDirty();
+
+  const Falling &falling() const { return falling_; }
+  const Falling &fallingNext() const { return fallingNext_; }
+
+  const Clear &cleared() const { return cleared_; }
+
+  uint64_t seed() const { return seed_; }
+  Randomizer randomizer() const { return pieces_.randomizer(); }
+  int difficulty() const { return difficulty_; }
+  int32_t gravity() const { return gravity_; }
+  int score() const { return score_; }
+  uint64_t ticks() const { return ticks_; }
+
+  bool collides(const Falling &falling) const;
+  int dropY(const Falling &falling) const;
+  Falling ghost() const;
+
+  int height(int x) const { return GAMEHEI - top_[x]; }
+
+  static const bool (*getShape(const Falling &falling))[4];
+  static const uint16_t *getRowMasks(const Falling &falling);
+
+private:
+  void spawn();
+  bool moveLeft();
+  bool moveRight();
+  bool turn();
+  bool skip();
+  void land();
+  void reduce(int y);
+  bool collides() const;
+
+private:
+  uint64_t seed_;
+  PieceSource pieces_;
+
+  uint16_t rows_[GAMEHEI + 4];
+  uint8_t cell_[GAMEHEI][GAMEWID];
+  int top_[GAMEWID];
+  uint16_t dirty_[GAMEHEI + 4];
+
+  Falling falling_, fallingNext_;
+
+  Clear cleared_;
+
+  int difficulty_;
+  int32_t gravity_, fall_;
+  int resting_;
+  int score_;
+  uint64_t ticks_;
+
+  bool over_;
+};
@@ -1,6 +1,200 @@
 #include "font.hh"
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstring>
+#include <iterator>
+#include <string>
+
+namespace
+{
+  std::atomic<uint64_t> g_nextId = 1;
+
+  constexpr size_t HEADERSIZE = 16;
+  constexpr size_t RANGESIZE = 12;
+
+  uint32_t getLE(const uint8_t *p, int size)
+  {
+    uint32_t value = 0;
+    for(int i = size - 1; i >= 0; --i)
+      value = value << 8 | p[i];
+    return value;
+  }
+
+  void putLE(std::string &out, uint32_t value, int size)
+  {
+    for(int i = 0; i < size; ++i)
+      out.push_back(char(value >> 8 * i));
+  }
+
+  std::vector<GlyphRange> normalizeRanges(std::vector<GlyphRange> ranges)
+  {
+    std::erase_if(ranges, [](GlyphRange r) { return !r.count; });
+    std::sort(ranges.begin(), ranges.end(), [](GlyphRange a, GlyphRange b) { return a.first < b.first; });
+
+    std::vector<GlyphRange> merged;
+
+    for(auto r : ranges)
+      if(!merged.empty() && r.first <= merged.back().first + merged.back().count)
+        merged.back().count = std::max(merged.back().first + merged.back().count, r.first + r.count) - merged.back().first;
+      else
+        merged.push_back(r);
+
+    return merged;
+  }
+
+  uint64_t rowMask(int w)
+  {
+    return w < Font::MAXWID ? (uint64_t(1) << w) - 1 : ~uint64_t(0);
+  }
+
+  // Transposes a 64x64 bit matrix in place: bit x of m[y] trades places with
+  // bit y of m[x]. Six rounds of block swaps instead of 4096 single bits.
+  void transpose64(uint64_t *m)
+  {
+    uint64_t mask = 0x00000000ffffffff;
+
+    for(int j = 32; j; j >>= 1, mask ^= mask << j)
+      for(int k = 0; k < 64; k = (k + j + 1) & ~j)
+      {
+        auto t = (m[k] >> j ^ m[k + j]) & mask;
+        m[k] ^= t << j;
+        m[k + j] ^= t;
+      }
+  }
+
+  // Bit streams in the glyph layout: bit `pos` is bit pos % 8 of byte pos / 8.
+  uint64_t getBits(const uint8_t *in, size_t pos, int n)
+  {
+    in += pos / 8;
+    int skip = pos % 8;
+    uint64_t bits = *in++ >> skip;
+
+    for(int got = 8 - skip; got < n; got += 8)
+      bits |= uint64_t(*in++) << got;
+
+    return bits & rowMask(n);
+  }
+
+  // ORs the low `n` bits of `bits` into a zeroed stream; the rest of `bits` must be clear.
+  void putBits(uint8_t *out, size_t pos, uint64_t bits, int n)
+  {
+    out += pos / 8;
+    int skip = pos % 8;
+
+    *out++ |= uint8_t(bits << skip);
+
+    for(n -= 8 - skip, bits >>= 8 - skip; n > 0; n -= 8, bits >>= 8)
+      *out++ |= uint8_t(bits);
+  }
+}
+
+std::optional<std::vector<GlyphRange>> parseGlyphRanges(std::string_view names)
+{
+  std::vector<GlyphRange> ranges;
+
+  while(!names.empty())
+  {
+    auto comma = names.find(',');
+    auto name = names.substr(0, comma);
+    names = comma == std::string_view::npos ? std::string_view() : names.substr(comma + 1);
+
+    if(name == "ascii")
+      ranges.push_back({0, 128});
+    else if(name == "latin1")
+      ranges.push_back({0, 256});
+    else if(name == "box")
+      ranges.push_back({0x2500, 0x80});
+    else if(auto dash = name.find('-'); dash != std::string_view::npos)
+    {
+      auto first = std::stoul(std::string(name.substr(0, dash)), nullptr, 16);
+      auto last = std::stoul(std::string(name.substr(dash + 1)), nullptr, 16);
+
+      if(last < first)
+        return std::nullopt;
+
+      ranges.push_back({uint32_t(first), uint32_t(last - first + 1)});
+    }
+    else
+      return std::nullopt;
+  }
+
+  return normalizeRanges(std::move(ranges));
+}
+
+bool FontView::matches(const uint8_t *data, size_t size)
+{
+  return size >= HEADERSIZE && memcmp(data, "TFNT", 4) == 0;
+}
+
+FontView::FontView(const uint8_t *data, size_t size)
+  : data_(data)
+{
+  if(!matches(data, size))
+    throw std::runtime_error("FontView: not a v2 font!");
+
+  if(getLE(data + 4, 2) != VERSION)
+    throw std::runtime_error("FontView: unsupported version!");
+
+  size_t numCodes = 0;
+  size_t rangesEnd = HEADERSIZE + numRanges() * RANGESIZE;
+
+  if(rangesEnd > size)
+    throw std::runtime_error("FontView: malformed range table!");
+
+  for(int i = 0; i < numRanges(); ++i)
+  {
+    if(range(i).first + range(i).count < range(i).first || getLE(data + HEADERSIZE + i * RANGESIZE + 8, 4) != numCodes)
+      throw std::runtime_error("FontView: malformed range table!");
+
+    numCodes += range(i).count;
+  }
+
+  auto numStored = getLE(data + 12, 4);
+
+  slotsOffset_ = rangesEnd;
+  glyphsOffset_ = (slotsOffset_ + numCodes * 2 + 3) & ~size_t(3);
+
+  if(glyphsOffset_ + size_t(numStored) * bytesPerGlyph() > size)
+    throw std::runtime_error("FontView: unexpected end of data!");
+
+  for(size_t i = 0; i < numCodes; ++i)
+    if(auto stored = getLE(data + slotsOffset_ + i * 2, 2); stored != NOSLOT && stored >= numStored)
+      throw std::runtime_error("FontView: malformed slot table!");
+}
+
+int FontView::bytesPerGlyph() const
+{
+  return getLE(data_ + 8, 2);
+}
+
+int FontView::numRanges() const
+{
+  return getLE(data_ + 10, 2);
+}
+
+GlyphRange FontView::range(int i) const
+{
+  auto p = data_ + HEADERSIZE + i * RANGESIZE;
+  return {getLE(p, 4), getLE(p + 4, 4)};
+}
+
+const uint8_t *FontView::glyph(int ch) const
+{
+  for(int i = 0; i < numRanges(); ++i)
+  {
+    auto p = data_ + HEADERSIZE + i * RANGESIZE;
+
+    if(uint32_t(ch) - getLE(p, 4) < getLE(p + 4, 4))
+    {
+      auto stored = getLE(data_ + slotsOffset_ + (getLE(p + 8, 4) + ch - getLE(p, 4)) * 2, 2);
+      return stored == NOSLOT ? nullptr : data_ + glyphsOffset_ + size_t(stored) * bytesPerGlyph();
+    }
+  }
+
+  return nullptr;
+}
 
 Font::~Font()
 {
@@ -24,6 +218,14 @@ Font &Font::operator=(Font &&other)
   w_ = other.w_;
   h_ = other.h_;
   bytesPerOne_ = other.bytesPerOne_;
+  numGlyphs_ = other.numGlyphs_;
+  id_ = other.id_;
+  ranges_ = std::move(other.ranges_);
+  format_ = other.format_;
+  rows_ = std::move(other.rows_);
+  rects_ = std::move(other.rects_);
+  rowsStale_ = std::move(other.rowsStale_);
+  rectsStale_ = std::move(other.rectsStale_);
   other.bytes_ = nullptr;
   return *this;
 }
@@ -32,15 +234,23 @@ Font &Font::operator=(const Font &other)
 {
   if(other.bytes_)
   {
-    if(!bytes_ || bytesPerOne_ != other.bytesPerOne_)
+    if(!bytes_ || bytesPerOne_ * numGlyphs_ != other.bytesPerOne_ * other.numGlyphs_)
     {
       drop();
-      bytesPerOne_ = other.bytesPerOne_;
-      bytes_ = new uint8_t[128 * bytesPerOne_];
+      bytes_ = new uint8_t[other.numGlyphs_ * other.bytesPerOne_];
     }
-    memcpy(bytes_, other.bytes_, 128 * bytesPerOne_);
+    bytesPerOne_ = other.bytesPerOne_;
+    numGlyphs_ = other.numGlyphs_;
+    memcpy(bytes_, other.bytes_, numGlyphs_ * bytesPerOne_);
     w_ = other.w_;
     h_ = other.h_;
+    id_ = g_nextId++;
+    ranges_ = other.ranges_;
+    format_ = other.format_;
+    rows_ = other.rows_;
+    rects_ = other.rects_;
+    rowsStale_ = other.rowsStale_;
+    rectsStale_ = other.rectsStale_;
   }
   else
   {
@@ -49,15 +259,30 @@ Font &Font::operator=(const Font &other)
   return *this;
 }
 
-void Font::init(int w, int h)
+void Font::init(int w, int h, std::vector<GlyphRange> ranges)
 {
   if(bytes_)
     throw std::runtime_error("Font::init(): font already initialized!");
 
+  if(w > MAXWID)
+    throw std::runtime_error("Font::init(): glyphs wider than 64 pixels are not supported!");
+
+  ranges_ = normalizeRanges(std::move(ranges));
+  format_ = ranges_ == std::vector<GlyphRange>{{0, 128}} ? FontFormat::V1 : FontFormat::V2;
+
+  numGlyphs_ = 0;
+  for(auto r : ranges_)
+    numGlyphs_ += r.count;
+
   w_ = w;
   h_ = h;
   bytesPerOne_ = w*h ? (w*h - 1) / 8 + 1 : 0;
-  bytes_ = new uint8_t[128 * bytesPerOne_]();
+  bytes_ = new uint8_t[numGlyphs_ * bytesPerOne_]();
+  id_ = g_nextId++;
+  rows_.assign(numGlyphs_ * h_, 0);
+  rects_.assign(numGlyphs_, {});
+  rowsStale_.assign(numGlyphs_, false);
+  rectsStale_.assign(numGlyphs_, false);
 }
 
 void Font::drop()
@@ -69,17 +294,55 @@ void Font::drop()
 }
 
 void Font::load(std::istream &in)
+{
+  std::vector<uint8_t> data;
+  data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+  load(data.data(), data.size());
+}
+
+void Font::load(const uint8_t *data, size_t size)
 {
   if(bytes_)
     throw std::runtime_error("Font::load(): font already initialized!");
 
-  uint8_t w, h;
-  in.read((char *)&w, 1);
-  in.read((char *)&h, 1);
+  if(FontView::matches(data, size))
+  {
+    FontView view(data, size);
+
+    std::vector<GlyphRange> ranges;
+    for(int i = 0; i < view.numRanges(); ++i)
+      ranges.push_back(view.range(i));
+
+    init(view.wid(), view.hei(), std::move(ranges));
+
+    if(view.bytesPerGlyph() != bytesPerOne_)
+      throw std::runtime_error("Font::load(): malformed header!");
+
+    for(auto [first, count] : ranges_)
+      for(auto ch = first; ch < first + count; ++ch)
+        if(auto glyph = view.glyph(ch))
+          memcpy(&bytes_[slot(ch) * bytesPerOne_], glyph, bytesPerOne_);
+
+    format_ = FontFormat::V2;
+  }
+  else
+  {
+    if(size < 2)
+      throw std::runtime_error("Font::load(): unexpected end of file!");
+
+    init(data[0], data[1]);
+
+    memcpy(bytes_, &data[2], std::min<size_t>(size - 2, numGlyphs_ * bytesPerOne_));
 
-  init(w, h);
+    format_ = FontFormat::V1;
+  }
 
-  in.read((char *)bytes_, 128 * bytesPerOne_);
+  for(int i = 0; i < numGlyphs_; ++i)
+  {
+    decodeRows(i);
+    buildRects(i);
+  }
 }
 
 void Font::store(std::ostream &out) const
@@ -87,14 +350,185 @@ void Font::store(std::ostream &out) const
   if(!bytes_)
     throw std::runtime_error("Font::store(): font not initialized!");
 
-  uint8_t w = w_, h = h_;
+  if(format_ == FontFormat::V1)
+  {
+    if(ranges_ != std::vector<GlyphRange>{{0, 128}})
+      throw std::runtime_error("Font::store(): v1 format holds ASCII only!");
+
+    uint8_t w = w_, h = h_;
+
+    out.write((char *)&w, 1);
+    out.write((char *)&h, 1);
+    out.write((char *)bytes_, numGlyphs_ * bytesPerOne_);
+    return;
+  }
+
+  std::vector<uint32_t> slots(numGlyphs_, FontView::NOSLOT);
+  uint32_t numStored = 0;
+
+  for(int i = 0; i < numGlyphs_; ++i)
+    if(std::any_of(&bytes_[i * bytesPerOne_], &bytes_[(i + 1) * bytesPerOne_], [](uint8_t byte) { return byte; }))
+      slots[i] = numStored++;
 
-  out.write((char *)&w, 1);
-  out.write((char *)&h, 1);
-  out.write((char *)bytes_, 128 * bytesPerOne_);
+  if(numStored >= FontView::NOSLOT)
+    throw std::runtime_error("Font::store(): too many glyphs for v2 format!");
+
+  std::string image = "TFNT";
+  putLE(image, FontView::VERSION, 2);
+  putLE(image, w_, 1);
+  putLE(image, h_, 1);
+  putLE(image, bytesPerOne_, 2);
+  putLE(image, ranges_.size(), 2);
+  putLE(image, numStored, 4);
+
+  for(uint32_t slotBase = 0; auto [first, count] : ranges_)
+  {
+    putLE(image, first, 4);
+    putLE(image, count, 4);
+    putLE(image, slotBase, 4);
+    slotBase += count;
+  }
+
+  for(auto stored : slots)
+    putLE(image, stored, 2);
+
+  image.resize((image.size() + 3) & ~size_t(3));
+
+  for(int i = 0; i < numGlyphs_; ++i)
+    if(slots[i] != FontView::NOSLOT)
+      image.append((char *)&bytes_[i * bytesPerOne_], bytesPerOne_);
+
+  out.write(image.data(), image.size());
 }
 
 void Font::erase(int ch)
 {
-  memset(&bytes_[ch * bytesPerOne_], 0, bytesPerOne_);
+  auto i = checkedSlot(ch);
+
+  memset(&bytes_[i * bytesPerOne_], 0, bytesPerOne_);
+  std::fill_n(&rows_[i * h_], h_, 0);
+  rects_[i].clear();
+  rowsStale_[i] = false;
+  rectsStale_[i] = false;
+}
+
+bool Font::isEmpty(int ch) const
+{
+  auto i = slot(ch);
+
+  return i < 0 || std::all_of(&bytes_[i * bytesPerOne_], &bytes_[(i + 1) * bytesPerOne_], [](uint8_t byte) { return !byte; });
+}
+
+void Font::setRow(int ch, int y, uint64_t bits)
+{
+  auto i = checkedSlot(ch);
+  auto glyph = BitsView2D(&bytes_[i * bytesPerOne_], w_, h_);
+
+  for(int x = 0; x < w_; ++x)
+    glyph[x][y] = bits >> x & 1;
+
+  if(!rowsStale_[i])
+    rows_[i * h_ + y] = bits & rowMask(w_);
+
+  rectsStale_[i] = true;
+}
+
+void Font::setGlyphRows(int ch, const uint64_t *rows)
+{
+  auto i = checkedSlot(ch);
+  auto glyph = &bytes_[i * bytesPerOne_];
+  auto mask = rowMask(w_);
+
+  memset(glyph, 0, bytesPerOne_);
+
+  // Rows are transposed into columns 64 at a time and each column is
+  // written as one run of bits.
+  uint64_t cols[64];
+
+  for(int y0 = 0; y0 < h_; y0 += 64)
+  {
+    int n = std::min(64, h_ - y0);
+
+    for(int y = 0; y < 64; ++y)
+      cols[y] = y < n ? rows[y0 + y] & mask : 0;
+
+    transpose64(cols);
+
+    for(int x = 0; x < w_; ++x)
+      putBits(glyph, size_t(x) * h_ + y0, cols[x], n);
+  }
+
+  for(int y = 0; y < h_; ++y)
+    rows_[i * h_ + y] = rows[y] & mask;
+
+  rowsStale_[i] = false;
+  rectsStale_[i] = true;
+}
+
+const std::vector<GlyphRect> &Font::rects(int ch) const
+{
+  static const std::vector<GlyphRect> none;
+
+  auto i = slot(ch);
+
+  if(i < 0)
+    return none;
+
+  if(rectsStale_[i])
+    buildRects(i);
+
+  return rects_[i];
+}
+
+void Font::decodeRows(int i) const
+{
+  auto glyph = &bytes_[i * bytesPerOne_];
+  auto rows = &rows_[i * h_];
+
+  uint64_t cols[64];
+
+  for(int y0 = 0; y0 < h_; y0 += 64)
+  {
+    int n = std::min(64, h_ - y0);
+
+    for(int x = 0; x < 64; ++x)
+      cols[x] = x < w_ ? getBits(glyph, size_t(x) * h_ + y0, n) : 0;
+
+    transpose64(cols);
+
+    std::copy_n(cols, n, &rows[y0]);
+  }
+
+  rowsStale_[i] = false;
+}
+
+void Font::buildRects(int i) const
+{
+  if(rowsStale_[i])
+    decodeRows(i);
+
+  std::vector<uint64_t> free(&rows_[i * h_], &rows_[(i + 1) * h_]);
+
+  auto &rects = rects_[i];
+  rects.clear();
+
+  for(int y = 0; y < h_; ++y)
+    while(free[y])
+    {
+      int x = std::countr_zero(free[y]);
+      int w = std::countr_one(free[y] >> x);
+      auto span = rowMask(w) << x;
+
+      int h = 1;
+
+      while(y + h < h_ && (free[y + h] & span) == span)
+        ++h;
+
+      for(int yi = y; yi < y + h; ++yi)
+        free[yi] &= ~span;
+
+      rects.push_back({uint8_t(x), uint8_t(y), uint8_t(w), uint8_t(h)});
+    }
+
+  rectsStale_[i] = false;
 }
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <iostream>
+#include <stdexcept>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 class BitView
 {
@@ -79,6 +84,59 @@ private:
   int w_, h_;
 };
 
+struct GlyphRect
+{
+  uint8_t x, y, w, h;
+};
+
+// Half-open range of character codes [first, first + count).
+struct GlyphRange
+{
+  uint32_t first, count;
+
+  bool operator==(const GlyphRange &other) const = default;
+};
+
+// Parses a comma-separated list of "ascii", "latin1", "box" or hex ranges like "2500-257f".
+std::optional<std::vector<GlyphRange>> parseGlyphRanges(std::string_view names);
+
+enum class FontFormat
+{
+  V1,  // 2-byte header and 128 dense ASCII glyphs
+  V2   // see FontView
+};
+
+// Read-only view of a v2 font image, used in place (e.g. over an mmapped file).
+// All fields are little-endian and naturally aligned:
+//   "TFNT", u16 version, u8 wid, u8 hei, u16 bytesPerGlyph, u16 numRanges, u32 numStored
+//   numRanges x {u32 first, u32 count, u32 slotBase}
+//   one u16 per code in the ranges: index of its stored glyph or NOSLOT if empty
+//   padding to 4 bytes, then numStored x bytesPerGlyph bytes of column-major
+//   glyph bits, as in v1
+class FontView
+{
+public:
+  static constexpr uint32_t VERSION = 2;
+  static constexpr uint32_t NOSLOT = 0xffff;
+
+  FontView(const uint8_t *data, size_t size);
+
+  static bool matches(const uint8_t *data, size_t size);
+
+  int wid() const { return data_[6]; }
+  int hei() const { return data_[7]; }
+  int bytesPerGlyph() const;
+  int numRanges() const;
+  GlyphRange range(int i) const;
+
+  // Packed bits of the glyph for `ch`, or nullptr if it is absent or empty.
+  const uint8_t *glyph(int ch) const;
+
+private:
+  const uint8_t *data_;
+  size_t slotsOffset_, glyphsOffset_;
+};
+
 class Font
 {
 public:
@@ -90,24 +148,96 @@ public:
   Font &operator=(Font &&other);
   Font &operator=(const Font &other);
   
-  void init(int w, int h);
+  void init(int w, int h, std::vector<GlyphRange> ranges = {{0, 128}});
   void drop();
 
   void load(std::istream &in);
+  void load(const uint8_t *data, size_t size);
 
   void store(std::ostream &out) const;
+
+  FontFormat format() const { return format_; }
+  void setFormat(FontFormat format) { format_ = format; }
   
   BitsView2D operator[](int ch)
   {
-    return BitsView2D(&bytes_[ch * bytesPerOne_], w_, h_);
+    auto i = checkedSlot(ch);
+    rowsStale_[i] = true;
+    rectsStale_[i] = true;
+    return BitsView2D(&bytes_[i * bytesPerOne_], w_, h_);
   }
+
+  // Decoded glyphs: one word per row with bit x set for lit pixel x, and the
+  // lit pixels merged greedily into rects. Both are built at load; writable
+  // access through operator[] marks the glyph stale until the next read.
+  // Codes outside the ranges read as empty; writing them throws.
+  uint64_t row(int ch, int y) const
+  {
+    auto i = slot(ch);
+
+    if(i < 0)
+      return 0;
+
+    if(rowsStale_[i])
+      decodeRows(i);
+
+    return rows_[i * h_ + y];
+  }
+
+  const std::vector<GlyphRect> &rects(int ch) const;
+
+  void setRow(int ch, int y, uint64_t bits);
+  // Replaces the whole glyph with `hei()` row words, packed a word at a time.
+  void setGlyphRows(int ch, const uint64_t *rows);
+  void flip(int ch, int x, int y) { setRow(ch, y, row(ch, y) ^ uint64_t(1) << x); }
   
   int wid() const { return w_; }
   int hei() const { return h_; }
+  uint64_t id() const { return id_; }
+
+  const std::vector<GlyphRange> &ranges() const { return ranges_; }
+  bool has(int ch) const { return slot(ch) >= 0; }
   
   void erase(int ch);
+  bool isEmpty(int ch) const;
     
+  static constexpr int MAXWID = 64;
+
 private:
+  int slot(int ch) const
+  {
+    for(int base = 0; auto [first, count] : ranges_)
+    {
+      if(uint32_t(ch) - first < count)
+        return base + ch - first;
+
+      base += count;
+    }
+
+    return -1;
+  }
+
+  int checkedSlot(int ch) const
+  {
+    auto i = slot(ch);
+
+    if(i < 0)
+      throw std::out_of_range("Font: character " + std::to_string(ch) + " is outside the font's ranges!");
+
+    return i;
+  }
+
+  void decodeRows(int i) const;
+  void buildRects(int i) const;
+
   uint8_t *bytes_ = nullptr;
-  int w_, h_, bytesPerOne_;
+  int w_, h_, bytesPerOne_, numGlyphs_;
+  uint64_t id_ = 0;
+
+  std::vector<GlyphRange> ranges_;
+  FontFormat format_ = FontFormat::V1;
+
+  mutable std::vector<uint64_t> rows_;
+  mutable std::vector<std::vector<GlyphRect>> rects_;
+  mutable std::vector<bool> rowsStale_, rectsStale_;
 };
@@ -0,0 +1,257 @@
+#include "font.hh"
+#include "fontutils.hh"
+#include "glyphblit.hh"
+#include "common/args.hh"
+#include "common/str2num.hh"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+  using Op = std::function<void(Font &)>;
+
+  std::vector<int> parseInts(std::string_view params, size_t count)
+  {
+    std::vector<int> ints;
+
+    while(!params.empty())
+    {
+      auto comma = params.find(',');
+      ints.push_back(str2num<int>(params.substr(0, comma)));
+      params = comma == std::string_view::npos ? std::string_view() : params.substr(comma + 1);
+    }
+
+    if(ints.size() != count)
+      throw std::runtime_error("expected " + std::to_string(count) + " parameters");
+
+    return ints;
+  }
+
+  template<class Transform>
+  Op glyphOp(Transform transform)
+  {
+    return [transform](Font &font) { font = mapGlyphs(font, transform); };
+  }
+
+  // Ops are "name" or "name:params", e.g. "pad:1,1,0,0", "clean:ABC", "format:v2".
+  Op parseOp(std::string_view spec)
+  {
+    auto colon = spec.find(':');
+    auto name = spec.substr(0, colon);
+    auto params = colon == std::string_view::npos ? std::string_view() : spec.substr(colon + 1);
+
+    if(name == "pad" || name == "crop" || name == "shift")
+    {
+      auto v = parseInts(params, name == "shift" ? 2 : 4);
+
+      if(name == "pad")
+        return glyphOp([=](const Bitmap &b) { return pad(b, v[0], v[1], v[2], v[3]); });
+      else if(name == "crop")
+        return glyphOp([=](const Bitmap &b) { return crop(b, v[0], v[1], v[2], v[3]); });
+      else
+        return glyphOp([=](const Bitmap &b) { return shift(b, v[0], v[1]); });
+    }
+
+    if(name == "rotate" || name == "upscale")
+    {
+      auto n = parseInts(params, 1)[0];
+
+      if(name == "rotate")
+        return glyphOp([=](const Bitmap &b) { return rotate(b, n); });
+      else
+        return glyphOp([=](const Bitmap &b) { return upscale(b, n); });
+    }
+
+    if(name == "mirrorx")
+      return glyphOp(mirrorX);
+    if(name == "mirrory")
+      return glyphOp(mirrorY);
+    if(name == "embolden")
+      return glyphOp(embolden);
+    if(name == "outline")
+      return glyphOp(outline);
+
+    if(name == "clean")
+    {
+      auto charsToKeep = std::string(params);
+
+      return [=](Font &font)
+      {
+        for(auto [first, count] : font.ranges())
+          for(auto c = first; c < first + count; ++c)
+            if(c >= 256 || charsToKeep.find(char(c)) == std::string::npos)
+              font.erase(c);
+      };
+    }
+
+    if(name == "format")
+    {
+      if(params != "v1" && params != "v2")
+        throw std::runtime_error("unknown format: " + std::string(params));
+
+      auto format = params == "v1" ? FontFormat::V1 : FontFormat::V2;
+      return [=](Font &font) { font.setFormat(format); };
+    }
+
+    throw std::runtime_error("unknown operation: " + std::string(spec));
+  }
+
+  std::vector<Op> parseChain(std::string_view chain)
+  {
+    std::vector<Op> ops;
+    std::istringstream in{std::string(chain)};
+
+    for(std::string spec; in >> spec;)
+      ops.push_back(parseOp(spec));
+
+    return ops;
+  }
+
+  std::atomic<unsigned> g_nextTmp = 0;
+
+  // Writes next to the target and renames over it, so readers never see a partial file.
+  // The temp name is unique per process and call, and the temp file is removed on failure.
+  void writeFontAtomically(const Font &font, const fs::path &path)
+  {
+    auto tmpPath = path;
+    tmpPath += ".tmp" + std::to_string(getpid()) + "-" + std::to_string(g_nextTmp++);
+
+    try
+    {
+      {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        font.store(out);
+
+        if(!out.flush())
+          throw std::runtime_error("cannot write " + tmpPath.string());
+      }
+
+      fs::rename(tmpPath, path);
+    }
+    catch(...)
+    {
+      std::error_code ignored;
+      fs::remove(tmpPath, ignored);
+      throw;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Args args(argc, argv, {{"c", "chain"},
+                         {"o", "out"},
+                         {"j", "jobs"}}, {{"q", "quiet"}});
+
+  auto ops = parseChain(args.get("chain"));
+  auto outDir = args.getStrO("out");
+  auto jobs = args.getIntO("jobs").value_or(std::max(1u, std::thread::hardware_concurrency()));
+
+  // Each job is an input file and its output path.
+  std::vector<std::pair<fs::path, fs::path>> files;
+
+  auto addFile = [&](const fs::path &path, const fs::path &relPath)
+  {
+    files.emplace_back(path, outDir ? fs::path(*outDir) / relPath : path);
+  };
+
+  for(auto target : std::span(args.targets()).subspan(1))
+  {
+    auto root = fs::path(target);
+
+    if(fs::is_directory(root))
+    {
+      for(auto &entry : fs::recursive_directory_iterator(root))
+        if(entry.is_regular_file() && entry.path().extension() == ".font")
+          addFile(entry.path(), fs::relative(entry.path(), root));
+    }
+    else
+    {
+      addFile(root, root.filename());
+    }
+  }
+
+  // Jobs sharing an output path would race and the last rename would win,
+  // so all of them fail before any work starts.
+  std::map<fs::path, int> outputUses;
+
+  for(auto &[inPath, outPath] : files)
+    outputUses[fs::absolute(outPath).lexically_normal()]++;
+
+  auto numFiles = files.size();
+
+  std::erase_if(files, [&](const auto &file)
+  {
+    if(outputUses[fs::absolute(file.second).lexically_normal()] == 1)
+      return false;
+
+    std::cerr << file.first.string() << ": output " << file.second.string() << " is shared with another input\n";
+    return true;
+  });
+
+  std::atomic<size_t> next = 0;
+  std::atomic<int> numFailed = numFiles - files.size();
+  std::mutex outputMutex;
+
+  auto worker = [&]
+  {
+    for(size_t i; (i = next++) < files.size();)
+    {
+      auto &[inPath, outPath] = files[i];
+
+      try
+      {
+        auto font = readFontFromFile(inPath);
+
+        for(auto &op : ops)
+          op(font);
+
+        if(outPath.has_parent_path())
+          fs::create_directories(outPath.parent_path());
+
+        writeFontAtomically(font, outPath);
+
+        if(!args.is("quiet"))
+        {
+          std::lock_guard lock(outputMutex);
+          std::cout << inPath.string() << " -> " << outPath.string() << '\n';
+        }
+      }
+      catch(const std::exception &e)
+      {
+        numFailed++;
+
+        std::lock_guard lock(outputMutex);
+        std::cerr << inPath.string() << ": " << e.what() << '\n';
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+
+  for(int t = 1; t < std::min<int>(jobs, files.size()); ++t)
+    pool.emplace_back(worker);
+
+  worker();
+
+  for(auto &thread : pool)
+    thread.join();
+
+  std::cerr << "FILES: " << numFiles << '\n'
+            << "FAILED: " << numFailed << '\n';
+
+  return numFailed ? 1 : 0;
+}
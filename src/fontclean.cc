@@ -15,9 +15,10 @@ int main(int argc, char **argv)
   
   auto charsToKeep = args.get("except");
   
-  for(int c = 0; c < 128; ++c)
-    if(charsToKeep.find(c) == std::string_view::npos)
-      font.erase(c);
+  for(auto [first, count] : font.ranges())
+    for(auto c = first; c < first + count; ++c)
+      if(c >= 256 || charsToKeep.find(char(c)) == std::string_view::npos)
+        font.erase(c);
 
   writeFontToFile(font, filename);
 }
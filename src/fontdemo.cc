@@ -3,16 +3,20 @@
 #include "fontutils.hh"
 #include "text.hh"
 #include "common/args.hh"
+#include "font68.hh"
 #include <algorithm>
+#include <fstream>
 
 int main(int argc, char **argv)
 {
   Args args(argc, argv, {{"f", "file"},
                          {"t", "text"},
-                         {"s", "scale"}}, {{"u", "uppercase"}});
+                         {"s", "scale"},
+                         {"o", "output"}}, {{"u", "uppercase"}});
 
-  auto file = args.get("file");
+  auto file = args.getStrO("file");
   auto scale = args.getIntO("scale").value_or(1);
+  auto output = args.getStrO("output");
 
   auto textArg = args.getO("text");
   auto text = textArg
@@ -25,15 +29,32 @@ int main(int argc, char **argv)
   
   auto [numRows, numCols] = getNumRowsAndCols(text);
   
-  auto font = readFontFromFile(file.data());
+  Font font;
+
+  if(file)
+    readFontFromFile(font, *file);
+  else
+    font.load(FONT68, sizeof(FONT68));
 
   Sdl::Context sdl;
-  sdl.init(text.data(), font.wid() * numCols, font.hei() * numRows, scale);
+  sdl.init(text.data(),
+           font.wid() * numCols,
+           font.hei() * numRows,
+           scale,
+           output ? Sdl::Backend::Offscreen : Sdl::Backend::Renderer);
   sdl.setColor(Sdl::BLACK);
   sdl.clear();
   
   sdl.setColor(Sdl::WHITE);
   renderText(text, {.sdl = sdl, .font = font});
+
+  if(output)
+  {
+    std::ofstream out(*output, std::ios::binary | std::ios::trunc);
+    sdl.writeFrame(out);
+    return 0;
+  }
+
   sdl.present();
   
   while(sdl.wait(), sdl.event().type != SDL_QUIT);
@@ -1,15 +1,37 @@
 #include "font.hh"
 #include "fontutils.hh"
+#include "glyphblit.hh"
 #include "sdlctx.hh"
 #include "common/args.hh"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <bit>
 #include <cstdlib>
 #include <cctype>
+#include <stdexcept>
 
 namespace fs = std::filesystem;
 
+namespace
+{
+  int decodeUtf8(const char *text)
+  {
+    auto bytes = (const unsigned char *)text;
+
+    if(bytes[0] < 0x80)
+      return bytes[0];
+
+    int len = bytes[0] >= 0xf0 ? 4 : bytes[0] >= 0xe0 ? 3 : 2;
+    int ch = bytes[0] & (0x7f >> len);
+
+    for(int i = 1; i < len && bytes[i]; ++i)
+      ch = ch << 6 | bytes[i] & 0x3f;
+
+    return ch;
+  }
+}
+
 class Edit
 {
 public:
@@ -32,7 +54,14 @@ void Edit::init(const Args &args)
   isNew_ = !fs::exists(filename_);
 
   if(isNew_)
-    font_.init(args.getInt("width"), args.getInt("height"));
+  {
+    auto ranges = parseGlyphRanges(args.getO("ranges").value_or("ascii"));
+
+    if(!ranges)
+      throw std::runtime_error("Unknown glyph ranges: " + args.getStr("ranges"));
+
+    font_.init(args.getInt("width"), args.getInt("height"), *ranges);
+  }
   else
     readFontFromFile(font_, filename_);
   
@@ -48,16 +77,15 @@ void Edit::exec()
   sdl.setColor(Sdl::WHITE);
   
   bool isEditMode = false;
-  int curCh = 0, curX = 0, curY = 0;
+  int curCh = font_.ranges().front().first, curX = 0, curY = 0;
 
   auto render = [&]
   {
     sdl.withColor(Sdl::BLACK)->clear();
     
-    for(int x = 0; x < w_; x++)
-      for(int y = 0; y < h_; y++)
-        if(font_[curCh][x][y])
-          sdl.pixArtPut(x, y, 4);
+    for(int y = 0; y < h_; y++)
+      for(auto bits = font_.row(curCh, y); bits; bits &= bits - 1)
+        sdl.pixArtPut(std::countr_zero(bits), y, 4);
     
     if(isEditMode)
       sdl.withColor(Sdl::gray(128))->pixArtPut(curX, curY, 4, 0.5);
@@ -71,6 +99,27 @@ void Edit::exec()
   {
     render();
 
+    if(sdl.event().type == SDL_KEYDOWN && sdl.event().key.keysym.mod & KMOD_CTRL)
+    {
+      auto glyph = getBitmap(font_, curCh);
+
+      switch(sdl.event().key.keysym.sym)
+      {
+        case SDLK_h: glyph = mirrorX(glyph); break;
+        case SDLK_v: glyph = mirrorY(glyph); break;
+        case SDLK_r: if(w_ == h_) glyph = rotate(glyph, 1); break;
+        case SDLK_b: glyph = embolden(glyph); break;
+        case SDLK_o: glyph = outline(glyph); break;
+        case SDLK_LEFT: glyph = shift(glyph, -1, 0); break;
+        case SDLK_RIGHT: glyph = shift(glyph, 1, 0); break;
+        case SDLK_UP: glyph = shift(glyph, 0, -1); break;
+        case SDLK_DOWN: glyph = shift(glyph, 0, 1); break;
+      }
+
+      putBitmap(font_, curCh, glyph);
+      continue;
+    }
+
     if(!isEditMode)
     {
       if(sdl.event().type == SDL_KEYDOWN)
@@ -85,6 +134,18 @@ void Edit::exec()
         {
           font_.erase(curCh);
         }
+        else if(sym == SDLK_PAGEUP || sym == SDLK_PAGEDOWN)
+        {
+          auto &ranges = font_.ranges();
+          auto step = sym == SDLK_PAGEUP ? -1 : 1;
+
+          do
+            curCh = curCh + step < 0 ? ranges.back().first + ranges.back().count - 1 : curCh + step;
+          while(!font_.has(curCh) && curCh < int(ranges.back().first + ranges.back().count));
+
+          if(!font_.has(curCh))
+            curCh = ranges.front().first;
+        }
         else if(sym == SDLK_ESCAPE)
         {
           break;
@@ -92,7 +153,8 @@ void Edit::exec()
       }
       else if(sdl.event().type == SDL_TEXTINPUT)
       {
-        curCh = sdl.event().text.text[0];
+        if(auto ch = decodeUtf8(sdl.event().text.text); font_.has(ch))
+          curCh = ch;
       }
     }
     else
@@ -118,7 +180,7 @@ void Edit::exec()
           case SDLK_RETURN:
           case SDLK_SPACE:
           case SDLK_LSHIFT:
-            font_[curCh][curX][curY].flip();
+            font_.flip(curCh, curX, curY);
           break;
           case SDLK_ESCAPE:
             isEditMode = false;
@@ -131,7 +193,7 @@ void Edit::exec()
           curX += dx;
           curY += dy;
           if(sdl.event().key.keysym.mod & KMOD_LSHIFT)
-            font_[curCh][curX][curY].flip();
+            font_.flip(curCh, curX, curY);
         }
       }
     }
@@ -150,7 +212,8 @@ int main(int argc, char **argv)
   Args args(argc, argv, {{"f", "file"},
                          {"w", "width"},
                          {"h", "height"},
-                         {"s", "scale"}}, {});
+                         {"s", "scale"},
+                         {"r", "ranges"}}, {});
 
   Edit edit;
   edit.init(args);
@@ -0,0 +1,45 @@
+#include "font.hh"
+#include "fontutils.hh"
+#include "common/args.hh"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <stdexcept>
+
+// Turns a font file into a header with the font image as a constexpr byte
+// array, so programs can use it without reading the file at startup.
+int main(int argc, char **argv)
+{
+  Args args(argc, argv, {{"i", "in"},
+                         {"o", "out"},
+                         {"n", "name"}}, {});
+
+  auto font = readFontFromFile(args.get("in").data());
+
+  std::stringstream image;
+  font.store(image);
+
+  auto bytes = image.str();
+
+  std::ofstream out(args.getStr("out"), std::ios::trunc);
+
+  if(!out)
+    throw std::runtime_error("cannot open " + args.getStr("out"));
+
+  out << "#pragma once\n"
+         "\n"
+         "#include <cstdint>\n"
+         "\n"
+         "// Generated by fontembed from " << args.get("in") << ". Do not edit.\n"
+         "inline constexpr uint8_t " << args.get("name") << "[] =\n"
+         "{";
+
+  for(size_t i = 0; i < bytes.size(); ++i)
+  {
+    char hex[8];
+    snprintf(hex, sizeof(hex), "0x%02x,", uint8_t(bytes[i]));
+    out << (i % 16 ? " " : "\n  ") << hex;
+  }
+
+  out << "\n};\n";
+}
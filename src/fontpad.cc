@@ -1,5 +1,6 @@
 #include "font.hh"
 #include "fontutils.hh"
+#include "glyphblit.hh"
 #include "common/args.hh"
 #include <fstream>
 #include <algorithm>
@@ -20,25 +21,7 @@ int main(int argc, char **argv)
   auto u = args.getIntO("up").value_or(0);
   auto d = args.getIntO("down").value_or(0);
 
-  auto iw = ifont.wid();
-  auto ih = ifont.hei();
-  auto ow = iw + l + r;
-  auto oh = ih + u + d;
-  
-  Font ofont;
-  ofont.init(ow, oh);
-
-  auto xShift = l;
-  auto yShift = u;
-  auto fromX = std::max(0, -xShift);
-  auto fromY = std::max(0, -yShift);
-  auto toX = std::min(iw, ow - xShift);
-  auto toY = std::min(ih, oh - yShift);
-
-  for(int c = 0; c < 128; ++c)
-    for(int x = fromX; x < toX; ++x)
-      for(int y = fromY; y < toY; ++y)
-        ofont[c][x+xShift][y+yShift] = bool(ifont[c][x][y]);
+  auto ofont = mapGlyphs(ifont, [&](const Bitmap &glyph) { return pad(glyph, l, r, u, d); });
   
   writeFontToFile(ofont, args.get("out").data());
 }
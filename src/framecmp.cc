@@ -0,0 +1,142 @@
+#include "ppm.hh"
+#include "common/args.hh"
+#include <filesystem>
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+  Image readPpmFromFile(const fs::path &path)
+  {
+    std::ifstream in(path, std::ios::binary);
+
+    if(!in)
+      throw std::runtime_error("cannot open " + path.string());
+
+    return readPpm(in);
+  }
+
+  int channelDiff(uint32_t a, uint32_t b, int shift)
+  {
+    return std::abs(int(a >> shift & 0xff) - int(b >> shift & 0xff));
+  }
+
+  // Returns the number of pixels that differ by more than `tolerance` in any channel,
+  // or -1 if the images have different sizes. Differing pixels are marked in `diff`.
+  int compare(const Image &golden, const Image &actual, int tolerance, Image &diff)
+  {
+    if(golden.wid != actual.wid || golden.hei != actual.hei)
+      return -1;
+
+    diff.wid = golden.wid;
+    diff.hei = golden.hei;
+    diff.pixels.resize(golden.pixels.size());
+
+    int numDiffs = 0;
+
+    for(size_t i = 0; i < golden.pixels.size(); i++)
+    {
+      auto a = golden.pixels[i], b = actual.pixels[i];
+      auto maxDiff = std::max({channelDiff(a, b, 24), channelDiff(a, b, 16), channelDiff(a, b, 8)});
+
+      if(maxDiff > tolerance)
+      {
+        numDiffs++;
+        diff.pixels[i] = 0xff0000ff;
+      }
+      else
+      {
+        diff.pixels[i] = (a >> 2 & 0x3f3f3f00) | 0xff;
+      }
+    }
+
+    return numDiffs;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Args args(argc, argv, {{"t", "tolerance"},
+                         {"d", "diff"}}, {{"q", "quiet"}});
+
+  if(args.targets().size() != 3)
+  {
+    std::cerr << "usage: framecmp [-t tolerance] [-d diffdir] [-q] GOLDEN ACTUAL\n";
+    return 2;
+  }
+
+  auto tolerance = args.getIntO("tolerance").value_or(0);
+  auto diffDir = args.getStrO("diff");
+  auto goldenPath = fs::path(args.targets()[1]);
+  auto actualPath = fs::path(args.targets()[2]);
+
+  std::vector<std::pair<fs::path, fs::path>> pairs;
+
+  if(fs::is_directory(goldenPath))
+  {
+    for(auto &entry : fs::directory_iterator(goldenPath))
+      if(entry.path().extension() == ".ppm")
+        pairs.emplace_back(entry.path(), actualPath / entry.path().filename());
+
+    std::sort(pairs.begin(), pairs.end());
+  }
+  else if(fs::exists(goldenPath))
+  {
+    pairs.emplace_back(goldenPath, actualPath);
+  }
+
+  // A check that compares nothing must not pass, e.g. with a wrong path or an empty checkout.
+  if(pairs.empty())
+  {
+    std::cerr << "framecmp: no golden frames found at " << goldenPath.string() << '\n';
+    return 2;
+  }
+
+  if(diffDir)
+    fs::create_directories(*diffDir);
+
+  int numFailed = 0;
+
+  for(auto &[golden, actual] : pairs)
+  {
+    Image diff;
+    int numDiffs;
+
+    if(!fs::exists(actual))
+      numDiffs = -2;
+    else
+      numDiffs = compare(readPpmFromFile(golden), readPpmFromFile(actual), tolerance, diff);
+
+    if(numDiffs != 0)
+      numFailed++;
+
+    if(numDiffs > 0 && diffDir)
+    {
+      std::ofstream out(fs::path(*diffDir) / golden.filename(), std::ios::binary | std::ios::trunc);
+      writePpm(out, diff.wid, diff.hei, diff.pixels.data());
+    }
+
+    if(numDiffs != 0 || !args.is("quiet"))
+    {
+      std::cout << golden.filename().string() << ": ";
+
+      switch(numDiffs)
+      {
+        case  0: std::cout << "OK\n"; break;
+        case -1: std::cout << "SIZE MISMATCH\n"; break;
+        case -2: std::cout << "MISSING\n"; break;
+        default: std::cout << numDiffs << " PIXELS DIFFER\n"; break;
+      }
+    }
+  }
+
+  std::cout << "FRAMES: " << pairs.size() << '\n'
+            << "FAILED: " << numFailed << '\n';
+
+  return numFailed ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+#include "glyphblit.hh"
+#include <stdexcept>
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+  uint64_t reverseBits(uint64_t v)
+  {
+    v = (v >> 1 & 0x5555555555555555) | (v & 0x5555555555555555) << 1;
+    v = (v >> 2 & 0x3333333333333333) | (v & 0x3333333333333333) << 2;
+    v = (v >> 4 & 0x0f0f0f0f0f0f0f0f) | (v & 0x0f0f0f0f0f0f0f0f) << 4;
+    v = (v >> 8 & 0x00ff00ff00ff00ff) | (v & 0x00ff00ff00ff00ff) << 8;
+    v = (v >> 16 & 0x0000ffff0000ffff) | (v & 0x0000ffff0000ffff) << 16;
+    return v >> 32 | v << 32;
+  }
+
+  uint64_t shiftRow(uint64_t row, int dx)
+  {
+    if(dx >= 64 || dx <= -64)
+      return 0;
+
+    return dx >= 0 ? row << dx : row >> -dx;
+  }
+
+  // Called before the result is allocated, so bad sizes fail here rather than in std::vector.
+  void checkSize(int w, int h)
+  {
+    if(w < 1 || w > Font::MAXWID)
+      throw std::runtime_error("glyphblit: glyph width out of range!");
+    if(h < 1)
+      throw std::runtime_error("glyphblit: glyph height out of range!");
+  }
+}
+
+Bitmap getBitmap(const Font &font, int ch)
+{
+  Bitmap b(font.wid(), font.hei());
+
+  for(int y = 0; y < b.hei; ++y)
+    b.rows[y] = font.row(ch, y);
+
+  return b;
+}
+
+void putBitmap(Font &font, int ch, const Bitmap &b)
+{
+  if(b.wid != font.wid() || b.hei != font.hei())
+    throw std::runtime_error("putBitmap(): size mismatch!");
+
+  font.setGlyphRows(ch, b.rows.data());
+}
+
+Bitmap pad(const Bitmap &b, int left, int right, int up, int down)
+{
+  checkSize(b.wid + left + right, b.hei + up + down);
+  Bitmap r(b.wid + left + right, b.hei + up + down);
+
+  auto mask = widthMask(r.wid);
+
+  for(int y = std::max(0, -up); y < std::min(b.hei, r.hei - up); ++y)
+    r.rows[y + up] = shiftRow(b.rows[y], left) & mask;
+
+  return r;
+}
+
+Bitmap crop(const Bitmap &b, int x, int y, int w, int h)
+{
+  return pad(b, -x, w - (b.wid - x), -y, h - (b.hei - y));
+}
+
+Bitmap shift(const Bitmap &b, int dx, int dy)
+{
+  return pad(b, dx, -dx, dy, -dy);
+}
+
+Bitmap mirrorX(const Bitmap &b)
+{
+  Bitmap r(b.wid, b.hei);
+
+  for(int y = 0; y < b.hei; ++y)
+    r.rows[y] = b.wid ? reverseBits(b.rows[y]) >> (64 - b.wid) : 0;
+
+  return r;
+}
+
+Bitmap mirrorY(const Bitmap &b)
+{
+  Bitmap r = b;
+  std::reverse(r.rows.begin(), r.rows.end());
+  return r;
+}
+
+Bitmap rotate(const Bitmap &b, int quarterTurns)
+{
+  switch(quarterTurns & 3)
+  {
+    case 0: return b;
+    case 2: return mirrorX(mirrorY(b));
+  }
+
+  // Clockwise: old pixel (x, y) moves to (hei - 1 - y, x).
+  checkSize(b.hei, b.wid);
+  Bitmap r(b.hei, b.wid);
+
+  for(int y = 0; y < b.hei; ++y)
+    for(auto bits = b.rows[y]; bits; bits &= bits - 1)
+      r.rows[std::countr_zero(bits)] |= uint64_t(1) << (b.hei - 1 - y);
+
+  return (quarterTurns & 3) == 1 ? r : mirrorX(mirrorY(r));
+}
+
+Bitmap upscale(const Bitmap &b, int factor)
+{
+  if(factor < 1)
+    throw std::runtime_error("upscale(): factor must be positive!");
+
+  // Checked before multiplying so a huge factor cannot overflow the size.
+  if(factor > Font::MAXWID / std::max(b.wid, 1))
+    throw std::runtime_error("glyphblit: glyph width out of range!");
+
+  checkSize(b.wid * factor, b.hei * factor);
+  Bitmap r(b.wid * factor, b.hei * factor);
+
+  auto run = widthMask(factor);
+
+  for(int y = 0; y < b.hei; ++y)
+  {
+    uint64_t row = 0;
+
+    for(auto bits = b.rows[y]; bits; bits &= bits - 1)
+      row |= run << std::countr_zero(bits) * factor;
+
+    std::fill_n(&r.rows[y * factor], factor, row);
+  }
+
+  return r;
+}
+
+Bitmap embolden(const Bitmap &b)
+{
+  Bitmap r(b.wid, b.hei);
+  auto mask = widthMask(b.wid);
+
+  for(int y = 0; y < b.hei; ++y)
+    r.rows[y] = (b.rows[y] | b.rows[y] << 1) & mask;
+
+  return r;
+}
+
+Bitmap outline(const Bitmap &b)
+{
+  Bitmap r(b.wid, b.hei);
+  auto mask = widthMask(b.wid);
+
+  for(int y = 0; y < b.hei; ++y)
+  {
+    auto near = b.rows[y];
+
+    if(y > 0)
+      near |= b.rows[y - 1];
+    if(y + 1 < b.hei)
+      near |= b.rows[y + 1];
+
+    r.rows[y] = (near | near << 1 | near >> 1) & mask & ~b.rows[y];
+  }
+
+  return r;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "font.hh"
+
+// Glyph bitmap with one word per row: bit x of rows[y] is pixel (x, y).
+// All operations work on whole rows with shifts and masks.
+struct Bitmap
+{
+  int wid = 0, hei = 0;
+  std::vector<uint64_t> rows;
+
+  Bitmap() = default;
+  Bitmap(int w, int h) : wid(w), hei(h), rows(h) {}
+};
+
+inline uint64_t widthMask(int w)
+{
+  return w < 64 ? (uint64_t(1) << w) - 1 : ~uint64_t(0);
+}
+
+Bitmap getBitmap(const Font &font, int ch);
+void putBitmap(Font &font, int ch, const Bitmap &bitmap);
+
+// Negative amounts crop.
+Bitmap pad(const Bitmap &b, int left, int right, int up, int down);
+Bitmap crop(const Bitmap &b, int x, int y, int w, int h);
+// Moves the content within the same size; pixels shifted out are dropped.
+Bitmap shift(const Bitmap &b, int dx, int dy);
+Bitmap mirrorX(const Bitmap &b);
+Bitmap mirrorY(const Bitmap &b);
+// Clockwise quarter turns; odd turns swap width and height.
+Bitmap rotate(const Bitmap &b, int quarterTurns);
+Bitmap upscale(const Bitmap &b, int factor);
+// Doubles every lit pixel to the right, keeping the size.
+Bitmap embolden(const Bitmap &b);
+// Pixels 8-adjacent to the glyph but not part of it.
+Bitmap outline(const Bitmap &b);
+
+// Applies `op` to every glyph. The result size is taken from `op` applied to
+// an empty bitmap, so `op` must map all glyphs of a font to the same size.
+template<class Op>
+Font mapGlyphs(const Font &font, Op op)
+{
+  auto size = op(Bitmap(font.wid(), font.hei()));
+
+  Font result;
+  result.init(size.wid, size.hei, font.ranges());
+  result.setFormat(font.format());
+
+  for(auto [first, count] : font.ranges())
+    for(auto ch = first; ch < first + count; ++ch)
+      if(!font.isEmpty(ch))
+        putBitmap(result, ch, op(getBitmap(font, ch)));
+
+  return result;
+}
@@ -0,0 +1,82 @@
+#include "hud.hh"
+#include "text.hh"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+  double toMs(Hud::Clock::duration d)
+  {
+    return std::chrono::duration<double, std::milli>(d).count();
+  }
+}
+
+void Hud::Samples::push(double value)
+{
+  values[next] = value;
+  next = (next + 1) % NSAMPLES;
+  size = std::min(size + 1, NSAMPLES);
+}
+
+double Hud::Samples::percentile(int p) const
+{
+  if(size == 0)
+    return 0.;
+
+  auto sorted = values;
+  auto nth = sorted.begin() + (size - 1) * p / 100;
+  std::nth_element(sorted.begin(), nth, sorted.begin() + size);
+
+  return *nth;
+}
+
+void Hud::recordFrame(Clock::duration frameTime)
+{
+  frameMs_.push(toMs(frameTime));
+}
+
+void Hud::recordTick(Clock::duration lateness)
+{
+  jitterMs_.push(toMs(lateness));
+}
+
+void Hud::recordInput(Uint32 timestamp)
+{
+  if(!pendingInput_)
+    pendingInput_ = timestamp;
+}
+
+void Hud::presented(Uint32 now)
+{
+  if(pendingInput_)
+  {
+    latencyMs_.push(now - *pendingInput_);
+    pendingInput_.reset();
+  }
+}
+
+void Hud::render(Sdl::Context &sdl, Font &font, double gravityPeriodMs)
+{
+  auto &stats = sdl.lastFrameStats();
+
+  char text[256];
+  snprintf(text, sizeof(text),
+           "FRAME %5.2f %5.2f %5.2f\n"
+           "JITTER %4.1f %4.1f /%5.0f\n"
+           "CALLS %d RECTS %d\n"
+           "STATE %d SKIP %d\n"
+           "LATENCY %3.0f %3.0f",
+           frameMs_.percentile(50), frameMs_.percentile(95), frameMs_.percentile(99),
+           jitterMs_.percentile(50), jitterMs_.percentile(99), gravityPeriodMs,
+           stats.drawCalls, stats.rects,
+           stats.stateCalls, stats.stateCallsSkipped,
+           latencyMs_.percentile(50), latencyMs_.percentile(99));
+
+  auto [numRows, numCols] = getNumRowsAndCols(text);
+
+  auto wcl = sdl.withColor(Sdl::BLACK);
+  sdl.fillRect(0, 0, (numCols + 1) * font.wid(), (numRows + 1) * font.hei());
+
+  sdl.setColor(Sdl::gray(192));
+  renderTextAt(text, {.sdl = sdl, .font = font}, {.pos = {font.wid() / 2, font.hei() / 2}});
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include "sdlctx.hh"
+#include "font.hh"
+
+// Timing overlay: frame time, tick jitter, draw calls and input latency.
+class Hud
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  bool visible() const { return visible_; }
+  void setVisible(bool visible) { visible_ = visible; }
+  void toggle() { visible_ = !visible_; }
+
+  void recordFrame(Clock::duration frameTime);
+  void recordTick(Clock::duration lateness);
+  void recordInput(Uint32 timestamp);
+  void presented(Uint32 now);
+
+  void render(Sdl::Context &sdl, Font &font, double gravityPeriodMs);
+
+private:
+  static constexpr int NSAMPLES = 256;
+
+  struct Samples
+  {
+    std::array<double, NSAMPLES> values;
+    int size = 0, next = 0;
+
+    void push(double value);
+    double percentile(int p) const;
+  };
+
+  Samples frameMs_, jitterMs_, latencyMs_;
+  std::optional<Uint32> pendingInput_;
+
+  bool visible_ = false;
+};
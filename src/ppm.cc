@@ -0,0 +1,49 @@
+#include "ppm.hh"
+#include <stdexcept>
+#include <string>
+
+void writePpm(std::ostream &out, int wid, int hei, const uint32_t *pixels)
+{
+  out << "P6\n" << wid << ' ' << hei << "\n255\n";
+
+  std::vector<char> row(wid * 3);
+
+  for(int y = 0; y < hei; y++)
+  {
+    for(int x = 0; x < wid; x++)
+    {
+      auto pixel = pixels[y * wid + x];
+      row[x * 3 + 0] = pixel >> 24;
+      row[x * 3 + 1] = pixel >> 16;
+      row[x * 3 + 2] = pixel >> 8;
+    }
+
+    out.write(row.data(), row.size());
+  }
+}
+
+Image readPpm(std::istream &in)
+{
+  std::string magic;
+  int maxVal;
+  Image image;
+
+  in >> magic >> image.wid >> image.hei >> maxVal;
+
+  if(!in || magic != "P6" || image.wid <= 0 || image.hei <= 0 || maxVal != 255)
+    throw std::runtime_error("readPpm(): unsupported image!");
+
+  in.get();
+
+  std::vector<unsigned char> data(image.wid * image.hei * 3);
+
+  if(!in.read((char *)data.data(), data.size()))
+    throw std::runtime_error("readPpm(): unexpected end of file!");
+
+  image.pixels.resize(image.wid * image.hei);
+
+  for(size_t i = 0; i < image.pixels.size(); i++)
+    image.pixels[i] = uint32_t(data[i * 3]) << 24 | uint32_t(data[i * 3 + 1]) << 16 | uint32_t(data[i * 3 + 2]) << 8 | 0xff;
+
+  return image;
+}
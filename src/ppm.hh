@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+struct Image
+{
+  int wid = 0, hei = 0;
+  std::vector<uint32_t> pixels;  // RGBA8888, row-major
+};
+
+void writePpm(std::ostream &out, int wid, int hei, const uint32_t *pixels);
+Image readPpm(std::istream &in);
@@ -0,0 +1,541 @@
+#include "replay.hh"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cstring>
+
+namespace
+{
+  constexpr char MAGIC[4] = {'T', 'R', 'P', 'L'};
+  constexpr char INDEXMAGIC[4] = {'T', 'I', 'D', 'X'};
+  constexpr uint8_t VERSION = 2;
+  constexpr int INPUTBITS = 3;
+  constexpr uint8_t KEYFRAMECODE = (1 << INPUTBITS) - 1;
+  constexpr size_t FOOTERSIZE = 8 + sizeof(INDEXMAGIC);
+  constexpr size_t HANDOVERSIZE = 4096;
+
+  class ByteReader
+  {
+  public:
+    ByteReader(const uint8_t *begin, const uint8_t *end)
+      : pos_(begin)
+      , end_(end)
+    {
+    }
+
+    bool atEnd() const { return pos_ == end_; }
+    const uint8_t *pos() const { return pos_; }
+
+    uint8_t byte()
+    {
+      if(pos_ == end_)
+        throw std::runtime_error("Replay::load(): unexpected end of file!");
+      return *pos_++;
+    }
+
+    uint64_t fixed(int numBytes)
+    {
+      uint64_t value = 0;
+      for(int i = 0; i < numBytes; i++)
+        value |= uint64_t(byte()) << (8 * i);
+      return value;
+    }
+
+    uint64_t varint()
+    {
+      uint64_t value = 0;
+
+      for(int shift = 0; shift < 64; shift += 7)
+      {
+        auto b = byte();
+        value |= uint64_t(b & 0x7f) << shift;
+        if(!(b & 0x80))
+          return value;
+      }
+
+      throw std::runtime_error("Replay::load(): malformed record!");
+    }
+
+    void skip(size_t numBytes)
+    {
+      if(numBytes > size_t(end_ - pos_))
+        throw std::runtime_error("Replay::load(): unexpected end of file!");
+      pos_ += numBytes;
+    }
+
+  private:
+    const uint8_t *pos_, *end_;
+  };
+
+  void putFixed(std::vector<uint8_t> &out, uint64_t value, int numBytes)
+  {
+    for(int i = 0; i < numBytes; i++)
+      out.push_back(value >> (8 * i));
+  }
+
+  void putVarint(std::vector<uint8_t> &out, uint64_t value)
+  {
+    while(value >= 0x80)
+    {
+      out.push_back(value | 0x80);
+      value >>= 7;
+    }
+
+    out.push_back(value);
+  }
+
+  void putFalling(std::vector<uint8_t> &out, const Engine::Falling &falling)
+  {
+    out.push_back(falling.shape ? falling.shape - g_shapes.data() : 0xff);
+    out.push_back(falling.col);
+    out.push_back(falling.v);
+    out.push_back(falling.y);
+    out.push_back(falling.x);
+  }
+
+  // Rejects pieces the engine could not index safely: every cell has to lie
+  // inside the board, since collides() and dropY() read rows and columns unchecked.
+  Engine::Falling getFalling(ByteReader &in)
+  {
+    Engine::Falling falling;
+
+    auto shape = in.byte();
+    falling.col = in.byte();
+    falling.v = in.byte() % 4;
+    falling.y = in.byte();
+    falling.x = in.byte();
+
+    if(shape >= NSHAPES || falling.col < 1 || falling.col > NCOLORS)
+      throw std::runtime_error("Replay: malformed keyframe!");
+
+    falling.shape = &g_shapes[shape];
+
+    for(int yRel = 0; yRel < 4; yRel++)
+      for(int xRel = 0; xRel < 4; xRel++)
+        if(falling.shape->views[falling.v][yRel][xRel] && (falling.y + yRel >= GAMEHEI || falling.x + xRel >= GAMEWID))
+          throw std::runtime_error("Replay: malformed keyframe!");
+
+    return falling;
+  }
+
+  std::vector<uint8_t> encodeKeyframe(const Engine::Snapshot &snapshot)
+  {
+    std::vector<uint8_t> out;
+
+    int top = 0;
+    while(top < GAMEHEI && std::all_of(&snapshot.cell[top][0], &snapshot.cell[top][GAMEWID], [](auto c) { return !c; }))
+      top++;
+
+    out.push_back(top);
+
+    uint8_t nibbles = 0;
+    int numNibbles = 0;
+
+    for(int y = top; y < GAMEHEI; y++)
+    {
+      uint16_t mask = 0;
+      for(int x = 0; x < GAMEWID; x++)
+        if(snapshot.cell[y][x])
+          mask |= 1 << x;
+
+      putFixed(out, mask, 2);
+    }
+
+    for(int y = top; y < GAMEHEI; y++)
+      for(int x = 0; x < GAMEWID; x++)
+        if(auto col = snapshot.cell[y][x])
+        {
+          nibbles |= col << (4 * numNibbles);
+          if(++numNibbles == 2)
+          {
+            out.push_back(nibbles);
+            nibbles = 0;
+            numNibbles = 0;
+          }
+        }
+
+    if(numNibbles)
+      out.push_back(nibbles);
+
+    putFalling(out, snapshot.falling);
+    putFalling(out, snapshot.fallingNext);
+
+    putVarint(out, snapshot.fall);
+    putVarint(out, snapshot.resting);
+    putVarint(out, snapshot.score);
+    out.push_back(snapshot.over);
+
+    for(auto word : snapshot.pieces.rng)
+      putFixed(out, word, 4);
+
+    out.insert(out.end(), snapshot.pieces.bag.begin(), snapshot.pieces.bag.end());
+    out.push_back(snapshot.pieces.bagPos);
+
+    return out;
+  }
+}
+
+void Replay::load(std::istream &in)
+{
+  bytes_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+  ByteReader reader(bytes_.data(), bytes_.data() + bytes_.size());
+
+  char magic[sizeof(MAGIC)];
+  for(auto &c : magic)
+    c = bytes_.size() >= sizeof(MAGIC) ? reader.byte() : 0;
+
+  if(memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw std::runtime_error("Replay::load(): not a replay file!");
+
+  auto version = reader.byte();
+
+  if(version < 1 || version > VERSION)
+    throw std::runtime_error("Replay::load(): unsupported version!");
+
+  header_.seed = reader.fixed(8);
+  header_.difficulty = reader.byte();
+  header_.randomizer = Randomizer(reader.byte());
+  header_.keyframeInterval = version >= 2 ? reader.varint() : 0;
+
+  if(header_.difficulty >= DIFFICULTYLIMIT || header_.randomizer > Randomizer::Bag)
+    throw std::runtime_error("Replay::load(): malformed header!");
+
+  auto recordsEnd = bytes_.data() + bytes_.size();
+  auto hasIndex = false;
+
+  if(version >= 2 && bytes_.size() >= FOOTERSIZE
+     && memcmp(&bytes_[bytes_.size() - sizeof(INDEXMAGIC)], INDEXMAGIC, sizeof(INDEXMAGIC)) == 0)
+  {
+    ByteReader footer(&bytes_[bytes_.size() - FOOTERSIZE], bytes_.data() + bytes_.size());
+    auto indexOffset = footer.fixed(8);
+
+    if(indexOffset < size_t(reader.pos() - bytes_.data()) || indexOffset > bytes_.size() - FOOTERSIZE)
+      throw std::runtime_error("Replay::load(): malformed index!");
+
+    recordsEnd = bytes_.data() + indexOffset;
+    hasIndex = true;
+  }
+
+  records_.clear();
+  keyframes_.clear();
+
+  // Keyframes as found among the records; the index has to agree with them.
+  std::vector<ReplayKeyframe> scanned;
+
+  ByteReader recordReader(reader.pos(), recordsEnd);
+  uint64_t tick = 0;
+
+  while(!recordReader.atEnd())
+  {
+    auto value = recordReader.varint();
+    tick += value >> INPUTBITS;
+
+    if((value & KEYFRAMECODE) == KEYFRAMECODE)
+    {
+      auto size = recordReader.varint();
+      auto offset = size_t(recordReader.pos() - bytes_.data());
+
+      recordReader.skip(size);
+
+      scanned.push_back({tick, offset, records_.size()});
+    }
+    else
+    {
+      records_.push_back({tick, Input(value & KEYFRAMECODE)});
+    }
+  }
+
+  if(!hasIndex)
+  {
+    keyframes_ = std::move(scanned);
+  }
+  else
+  {
+    ByteReader indexReader(recordsEnd, bytes_.data() + bytes_.size() - FOOTERSIZE);
+
+    auto count = indexReader.varint();
+
+    for(uint64_t i = 0; i < count; i++)
+    {
+      ReplayKeyframe keyframe;
+      keyframe.tick = indexReader.varint();
+      keyframe.offset = indexReader.varint();
+      keyframe.recordPos = indexReader.varint();
+
+      auto found = std::lower_bound(scanned.begin(), scanned.end(), keyframe.offset,
+                                    [](const ReplayKeyframe &k, size_t offset) { return k.offset < offset; });
+
+      if(found == scanned.end() || found->offset != keyframe.offset || found->tick != keyframe.tick
+         || found->recordPos != keyframe.recordPos
+         || !keyframes_.empty() && keyframe.tick <= keyframes_.back().tick)
+        throw std::runtime_error("Replay::load(): malformed index!");
+
+      keyframes_.push_back(keyframe);
+    }
+  }
+}
+
+void Replay::start(Engine &engine) const
+{
+  engine.start(header_.seed, header_.difficulty, header_.randomizer);
+}
+
+void Replay::play(Engine &engine) const
+{
+  size_t recordPos = 0;
+
+  start(engine);
+  advance(engine, recordPos, endTick());
+}
+
+void Replay::advance(Engine &engine, size_t &recordPos, uint64_t tick) const
+{
+  while(true)
+  {
+    while(recordPos < records_.size() && records_[recordPos].tick <= engine.ticks())
+      engine.input(records_[recordPos++].input);
+
+    if(engine.ticks() >= tick || engine.over())
+      break;
+
+    engine.tick();
+  }
+}
+
+void Replay::seek(Engine &engine, size_t &recordPos, uint64_t tick) const
+{
+  auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), tick,
+                             [](uint64_t tick, const ReplayKeyframe &keyframe) { return tick < keyframe.tick; });
+
+  if(it == keyframes_.begin())
+  {
+    start(engine);
+    recordPos = 0;
+  }
+  else
+  {
+    auto &keyframe = *std::prev(it);
+    engine.restore(decodeKeyframe(keyframe));
+    recordPos = keyframe.recordPos;
+  }
+
+  advance(engine, recordPos, tick);
+}
+
+Engine::Snapshot Replay::decodeKeyframe(const ReplayKeyframe &keyframe) const
+{
+  Engine::Snapshot snapshot = {};
+
+  snapshot.seed = header_.seed;
+  snapshot.difficulty = header_.difficulty;
+  snapshot.ticks = keyframe.tick;
+
+  ByteReader in(&bytes_[keyframe.offset], bytes_.data() + bytes_.size());
+
+  int top = std::min<int>(in.byte(), GAMEHEI);
+  uint16_t masks[GAMEHEI];
+
+  for(int y = top; y < GAMEHEI; y++)
+    masks[y] = in.fixed(2);
+
+  uint8_t nibbles = 0;
+  int numNibbles = 0;
+
+  for(int y = top; y < GAMEHEI; y++)
+    for(int x = 0; x < GAMEWID; x++)
+      if(masks[y] & (1 << x))
+      {
+        if(numNibbles == 0)
+          nibbles = in.byte();
+
+        snapshot.cell[y][x] = (nibbles >> (4 * numNibbles)) & 0xf;
+        numNibbles = (numNibbles + 1) % 2;
+
+        if(snapshot.cell[y][x] > NCOLORS)
+          throw std::runtime_error("Replay: malformed keyframe!");
+      }
+
+  snapshot.falling = getFalling(in);
+  snapshot.fallingNext = getFalling(in);
+
+  auto fall = in.varint();
+  if(fall > ONEROW)
+    throw std::runtime_error("Replay: malformed keyframe!");
+
+  snapshot.fall = fall;
+  snapshot.resting = in.varint();
+  snapshot.score = in.varint();
+  snapshot.over = in.byte();
+
+  for(auto &word : snapshot.pieces.rng)
+    word = in.fixed(4);
+
+  snapshot.pieces.randomizer = header_.randomizer;
+
+  for(auto &shape : snapshot.pieces.bag)
+    shape = in.byte() % NSHAPES;
+
+  snapshot.pieces.bagPos = std::min<int>(in.byte(), NSHAPES);
+
+  return snapshot;
+}
+
+ReplayWriter::~ReplayWriter()
+{
+  if(isOpen())
+    close(lastTick_);
+}
+
+void ReplayWriter::open(const std::string &path, const ReplayHeader &header)
+{
+  if(isOpen())
+    throw std::runtime_error("ReplayWriter::open(): already open!");
+
+  out_.open(path, std::ios::binary | std::ios::trunc);
+
+  if(!out_)
+    throw std::runtime_error("ReplayWriter::open(): cannot open " + path);
+
+  front_.clear();
+  back_.clear();
+  closing_ = false;
+  failed_ = false;
+
+  header_ = header;
+  size_ = 0;
+  lastTick_ = 0;
+  lastKeyframeTick_ = 0;
+  numRecords_ = 0;
+  index_.clear();
+
+  for(auto c : MAGIC)
+    put(c);
+  put(VERSION);
+  for(int i = 0; i < 8; i++)
+    put(header.seed >> (8 * i));
+  put(header.difficulty);
+  put(uint8_t(header.randomizer));
+  putVarint(header.keyframeInterval);
+
+  thread_ = std::thread(&ReplayWriter::run, this);
+}
+
+void ReplayWriter::record(uint64_t tick, Input input)
+{
+  putVarint((tick - lastTick_) << INPUTBITS | uint8_t(input));
+  lastTick_ = tick;
+  numRecords_++;
+
+  if(front_.size() >= HANDOVERSIZE)
+    handOver();
+}
+
+void ReplayWriter::checkpoint(const Engine &engine)
+{
+  if(header_.keyframeInterval <= 0 || engine.ticks() < lastKeyframeTick_ + header_.keyframeInterval)
+    return;
+
+  auto payload = encodeKeyframe(engine.snapshot());
+
+  putVarint((engine.ticks() - lastTick_) << INPUTBITS | KEYFRAMECODE);
+  putVarint(payload.size());
+
+  index_.push_back({engine.ticks(), size_, numRecords_});
+
+  for(auto byte : payload)
+    put(byte);
+
+  lastTick_ = engine.ticks();
+  lastKeyframeTick_ = engine.ticks();
+
+  if(front_.size() >= HANDOVERSIZE)
+    handOver();
+}
+
+bool ReplayWriter::close(uint64_t tick)
+{
+  record(tick, Input::None);
+
+  auto indexOffset = size_;
+
+  putVarint(index_.size());
+
+  for(auto &keyframe : index_)
+  {
+    putVarint(keyframe.tick);
+    putVarint(keyframe.offset);
+    putVarint(keyframe.recordPos);
+  }
+
+  for(int i = 0; i < 8; i++)
+    put(indexOffset >> (8 * i));
+  for(auto c : INDEXMAGIC)
+    put(c);
+
+  {
+    std::lock_guard lock(mutex_);
+    back_.insert(back_.end(), front_.begin(), front_.end());
+    front_.clear();
+    closing_ = true;
+  }
+
+  cv_.notify_one();
+  thread_.join();
+
+  out_.close();
+
+  return !failed_ && !out_.fail();
+}
+
+void ReplayWriter::putVarint(uint64_t value)
+{
+  while(value >= 0x80)
+  {
+    put(value | 0x80);
+    value >>= 7;
+  }
+
+  put(value);
+}
+
+void ReplayWriter::handOver()
+{
+  std::unique_lock lock(mutex_, std::try_to_lock);
+
+  if(!lock || !back_.empty())
+    return;
+
+  std::swap(front_, back_);
+
+  lock.unlock();
+  cv_.notify_one();
+}
+
+void ReplayWriter::run()
+{
+  std::vector<uint8_t> chunk;
+
+  while(true)
+  {
+    bool done;
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this] { return !back_.empty() || closing_; });
+      std::swap(chunk, back_);
+      done = closing_;
+    }
+
+    // After a failed write the rest is dropped; close() reports the failure.
+    if(!failed_ && !out_.write((const char *)chunk.data(), chunk.size()))
+      failed_ = true;
+
+    chunk.clear();
+
+    if(done)
+      break;
+  }
+
+  if(!failed_ && !out_.flush())
+    failed_ = true;
+}
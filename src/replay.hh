@@ -0,0 +1,94 @@
+#pragma once
+
+#include "engine.hh"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct ReplayHeader
+{
+  uint64_t seed;
+  int difficulty;
+  Randomizer randomizer;
+  int keyframeInterval = 0;
+};
+
+struct ReplayRecord
+{
+  uint64_t tick;
+  Input input;
+};
+
+struct ReplayKeyframe
+{
+  uint64_t tick;
+  size_t offset;
+  size_t recordPos;
+};
+
+class Replay
+{
+public:
+  void load(std::istream &in);
+
+  void start(Engine &engine) const;
+  void play(Engine &engine) const;
+
+  void advance(Engine &engine, size_t &recordPos, uint64_t tick) const;
+  void seek(Engine &engine, size_t &recordPos, uint64_t tick) const;
+
+  const ReplayHeader &header() const { return header_; }
+  const std::vector<ReplayRecord> &records() const { return records_; }
+  const std::vector<ReplayKeyframe> &keyframes() const { return keyframes_; }
+
+  uint64_t endTick() const { return records_.empty() ? 0 : records_.back().tick; }
+
+private:
+  Engine::Snapshot decodeKeyframe(const ReplayKeyframe &keyframe) const;
+
+private:
+  ReplayHeader header_;
+  std::vector<uint8_t> bytes_;
+  std::vector<ReplayRecord> records_;
+  std::vector<ReplayKeyframe> keyframes_;
+};
+
+class ReplayWriter
+{
+public:
+  ReplayWriter() = default;
+  ~ReplayWriter();
+
+  void open(const std::string &path, const ReplayHeader &header);
+  void record(uint64_t tick, Input input);
+  void checkpoint(const Engine &engine);
+  // Returns false if any part of the replay could not be written.
+  bool close(uint64_t tick);
+
+  bool isOpen() const { return thread_.joinable(); }
+
+private:
+  void put(uint8_t byte) { front_.push_back(byte); size_++; }
+  void putVarint(uint64_t value);
+  void handOver();
+  void run();
+
+private:
+  std::ofstream out_;
+
+  std::vector<uint8_t> front_, back_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool closing_;
+  bool failed_;
+
+  ReplayHeader header_;
+  size_t size_;
+  uint64_t lastTick_, lastKeyframeTick_;
+  size_t numRecords_;
+  std::vector<ReplayKeyframe> index_;
+};
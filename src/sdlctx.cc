@@ -1,5 +1,13 @@
 #include "sdlctx.hh"
+#include "ppm.hh"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace
 {
@@ -16,6 +24,26 @@ namespace
             Uint8(std::min(255., g*fixFactor)),
             Uint8(std::min(255., b*fixFactor))};
   }
+
+  uint32_t toRGBA8888(Sdl::Color c)
+  {
+    return uint32_t(c.r) << 24 | uint32_t(c.g) << 16 | uint32_t(c.b) << 8 | 0xff;
+  }
+
+  void fillSpan(uint32_t *dst, int n, uint32_t value)
+  {
+#ifdef __SSE2__
+    auto wide = _mm_set1_epi32(value);
+
+    for(; n >= 8; n -= 8, dst += 8)
+    {
+      _mm_storeu_si128((__m128i *)dst, wide);
+      _mm_storeu_si128((__m128i *)(dst + 4), wide);
+    }
+#endif
+
+    std::fill_n(dst, n, value);
+  }
 }
 
 const Sdl::Color Sdl::BLACK   = Sdl::gray(0),
@@ -28,8 +56,24 @@ const Sdl::Color Sdl::BLACK   = Sdl::gray(0),
                  Sdl::MAGENTA = fixLum(Sdl::magenta(255)),
                  Sdl::CYAN    = fixLum(Sdl::cyan(255));
 
-void Sdl::Context::init(const char *title, int w, int h, int scale)
+void Sdl::Context::init(const char *title, int w, int h, int scale, Backend backend)
 {
+  backend_ = backend;
+
+  if(usesFramebuffer())
+    framebuffer_.assign(w * h, toRGBA8888(color_));
+
+  initialized_ = true;
+
+  wid_ = w;
+  hei_ = h;
+
+  if(backend_ == Backend::Offscreen)
+  {
+    SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER);
+    return;
+  }
+
   SDL_Init(SDL_INIT_EVERYTHING);
 
   window_ = SDL_CreateWindow(title,
@@ -37,46 +81,133 @@ void Sdl::Context::init(const char *title, int w, int h, int scale)
                              SDL_WINDOWPOS_UNDEFINED,
                              w * scale,
                              h * scale,
-                             SDL_WINDOW_OPENGL);
+                             SDL_WINDOW_RESIZABLE | (backend_ == Backend::Renderer ? SDL_WINDOW_OPENGL : 0));
 
-  renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+  renderer_ = SDL_CreateRenderer(window_, -1, backend_ == Backend::Renderer ? SDL_RENDERER_ACCELERATED
+                                                                            : SDL_RENDERER_SOFTWARE);
 
-  SDL_RenderSetScale(renderer_, scale, scale);
-  SDL_RenderSetIntegerScale(renderer_, SDL_TRUE);
-  
-  initialized_ = true;
+  // The logical frame is drawn into a texture of its own size and blitted to
+  // the window with one nearest-neighbour copy at the largest integer scale.
+  SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
 
-  wid_ = w;
-  hei_ = h;
+  frameTexture_ = SDL_CreateTexture(renderer_,
+                                    SDL_PIXELFORMAT_RGBA8888,
+                                    backend_ == Backend::Renderer ? SDL_TEXTUREACCESS_TARGET : SDL_TEXTUREACCESS_STREAMING,
+                                    w,
+                                    h);
+
+  if(frameTexture_)
+  {
+    owned_.push_back(frameTexture_);
+
+    if(backend_ == Backend::Renderer)
+      SDL_SetRenderTarget(renderer_, frameTexture_);
+  }
+  else
+  {
+    SDL_RenderSetScale(renderer_, scale, scale);
+    SDL_RenderSetIntegerScale(renderer_, SDL_TRUE);
+  }
+
+  SDL_SetRenderDrawColor(renderer_, color_.r, color_.g, color_.b, 0xff);
+  SDL_SetRenderDrawBlendMode(renderer_, blendMode_);
 }
 
 Sdl::Context::~Context()
 {
+  for(auto [key, texture] : textures_)
+    SDL_DestroyTexture(texture);
+
+  for(auto texture : owned_)
+    SDL_DestroyTexture(texture);
+
   if(initialized_)
     SDL_Quit();
 }
 
-Sdl::Color Sdl::Context::getColor()
+void Sdl::Context::setColor(Color color)
+{
+  if(color == color_)
+  {
+    stats_.stateCallsSkipped++;
+    return;
+  }
+
+  color_ = color;
+
+  if(usesFramebuffer())
+    return;
+
+  flush();
+  SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, 0xff);
+  stats_.stateCalls++;
+}
+
+void Sdl::Context::setBlendMode(SDL_BlendMode blendMode)
 {
-  Uint8 r, g, b, a;
-  SDL_GetRenderDrawColor(renderer_, &r, &g, &b, &a);
-  return {r, g, b};
+  if(blendMode == blendMode_)
+  {
+    stats_.stateCallsSkipped++;
+    return;
+  }
+
+  if(!renderer_)
+  {
+    blendMode_ = blendMode;
+    return;
+  }
+
+  flush();
+  SDL_SetRenderDrawBlendMode(renderer_, blendMode);
+  stats_.stateCalls++;
+  blendMode_ = blendMode;
 }
 
-void Sdl::Context::setColor(Color color)
+void Sdl::Context::setTextureColor(SDL_Texture *texture, Color color)
 {
-  SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, 0xff);
+  auto [it, inserted] = textureColors_.try_emplace(texture, color);
+
+  if(!inserted && it->second == color)
+  {
+    stats_.stateCallsSkipped++;
+    return;
+  }
+
+  SDL_SetTextureColorMod(texture, color.r, color.g, color.b);
+  stats_.stateCalls++;
+  it->second = color;
 }
 
 void Sdl::Context::clear()
 {
+  if(usesFramebuffer())
+    return fillSpan(framebuffer_.data(), framebuffer_.size(), toRGBA8888(color_));
+
+  batch_.clear();
   SDL_RenderClear(renderer_);
+  stats_.drawCalls++;
 }
 
 void Sdl::Context::fillRect(int x, int y, int w, int h)
 {
-  SDL_RenderFillRect(renderer_,
-    &(const SDL_Rect &)SDL_Rect{baseX_ + x, baseY_ + y, w, h});
+  if(usesFramebuffer())
+  {
+    int x0 = std::max(baseX_ + x, 0), x1 = std::min(baseX_ + x + w, wid_);
+    int y0 = std::max(baseY_ + y, 0), y1 = std::min(baseY_ + y + h, hei_);
+
+    if(x0 >= x1)
+      return;
+
+    auto rgba = toRGBA8888(color_);
+
+    for(int row = y0; row < y1; row++)
+      fillSpan(&framebuffer_[row * wid_ + x0], x1 - x0, rgba);
+
+    stats_.rects++;
+    return;
+  }
+
+  batch_.push_back({baseX_ + x, baseY_ + y, w, h});
 }
 
 void Sdl::Context::pixArtPut(int x, int y, int step, float frac)
@@ -89,18 +220,208 @@ void Sdl::Context::pixArtPut(int x, int y, int step, float frac)
            size);
 }
 
+void Sdl::Context::copy(SDL_Texture *texture, const SDL_Rect &src, const SDL_Rect &dst)
+{
+  flush();
+
+  SDL_RenderCopy(renderer_, texture, &src,
+    &(const SDL_Rect &)SDL_Rect{baseX_ + dst.x, baseY_ + dst.y, dst.w, dst.h});
+
+  stats_.drawCalls++;
+}
+
+SDL_Texture *Sdl::Context::createTarget(int w, int h)
+{
+  if(!hasTextures())
+    return nullptr;
+
+  auto target = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+
+  if(target)
+    owned_.push_back(target);
+
+  return target;
+}
+
+SDL_Texture *Sdl::Context::createTexture(int w, int h, const uint32_t *pixels)
+{
+  if(!hasTextures())
+    return nullptr;
+
+  auto texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, w, h);
+
+  if(!texture)
+    return nullptr;
+
+  SDL_UpdateTexture(texture, nullptr, pixels, w * sizeof(uint32_t));
+  owned_.push_back(texture);
+
+  return texture;
+}
+
+void Sdl::Context::setTarget(SDL_Texture *target)
+{
+  if(target == target_)
+  {
+    stats_.stateCallsSkipped++;
+    return;
+  }
+
+  flush();
+  SDL_SetRenderTarget(renderer_, target ? target : frameTexture_);
+  stats_.stateCalls++;
+  target_ = target;
+}
+
+SDL_Texture *Sdl::Context::findTexture(const TextureKey &key) const
+{
+  if(auto it = textures_.find(key); it != textures_.end())
+    return it->second;
+  else
+    return nullptr;
+}
+
+void Sdl::Context::storeTexture(const TextureKey &key, SDL_Texture *texture)
+{
+  if(auto &stored = textures_[key]; stored != texture)
+  {
+    if(stored)
+    {
+      textureColors_.erase(stored);
+      SDL_DestroyTexture(stored);
+    }
+    stored = texture;
+  }
+}
+
+void Sdl::Context::flush()
+{
+  if(batch_.empty())
+    return;
+
+  SDL_RenderFillRects(renderer_, batch_.data(), batch_.size());
+
+  stats_.drawCalls++;
+  stats_.rects += batch_.size();
+
+  batch_.clear();
+}
+
+void Sdl::Context::writeFrame(std::ostream &out)
+{
+  if(usesFramebuffer())
+    return writePpm(out, wid_, hei_, framebuffer_.data());
+
+  flush();
+
+  int w = wid_, h = hei_;
+
+  if(!frameTexture_)
+    SDL_GetRendererOutputSize(renderer_, &w, &h);
+
+  std::vector<uint32_t> pixels(w * h);
+  SDL_RenderReadPixels(renderer_, nullptr, SDL_PIXELFORMAT_RGBA8888, pixels.data(), w * sizeof(uint32_t));
+
+  writePpm(out, w, h, pixels.data());
+}
+
 void Sdl::Context::present()
 {
+  if(!dumpPrefix_.empty())
+  {
+    char number[16];
+    snprintf(number, sizeof(number), "%06d", numFrames_);
+
+    std::ofstream out(dumpPrefix_ + number + ".ppm", std::ios::binary | std::ios::trunc);
+    writeFrame(out);
+  }
+
+  numFrames_++;
+
+  flush();
+
+  if(backend_ == Backend::Software && frameTexture_)
+    SDL_UpdateTexture(frameTexture_, nullptr, framebuffer_.data(), wid_ * sizeof(uint32_t));
+
+  showFrame();
+
+  lastFrameStats_ = stats_;
+  stats_ = {};
+}
+
+void Sdl::Context::showFrame()
+{
+  if(!renderer_)
+    return;
+
+  if(frameTexture_)
+  {
+    SDL_SetRenderTarget(renderer_, nullptr);
+
+    int outW, outH;
+    SDL_GetRendererOutputSize(renderer_, &outW, &outH);
+
+    auto scale = std::max(1, std::min(outW / wid_, outH / hei_));
+    auto dst = SDL_Rect{(outW - wid_ * scale) / 2, (outH - hei_ * scale) / 2, wid_ * scale, hei_ * scale};
+
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 0xff);
+    SDL_RenderClear(renderer_);
+    SDL_RenderCopy(renderer_, frameTexture_, nullptr, &dst);
+    SDL_SetRenderDrawColor(renderer_, color_.r, color_.g, color_.b, 0xff);
+
+    stats_.drawCalls += 2;
+  }
+
   SDL_RenderPresent(renderer_);
+
+  if(frameTexture_ && backend_ == Backend::Renderer)
+    SDL_SetRenderTarget(renderer_, target_ ? target_ : frameTexture_);
+}
+
+void Sdl::Context::toggleFullscreen()
+{
+  if(window_)
+    SDL_SetWindowFullscreen(window_, SDL_GetWindowFlags(window_) & SDL_WINDOW_FULLSCREEN_DESKTOP
+                                   ? 0
+                                   : SDL_WINDOW_FULLSCREEN_DESKTOP);
+}
+
+void Sdl::Context::handleWindowEvent()
+{
+  if(event_.type == SDL_WINDOWEVENT && (event_.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ||
+                                        event_.window.event == SDL_WINDOWEVENT_EXPOSED))
+    showFrame();
+  else if(event_.type == SDL_KEYDOWN && event_.key.keysym.sym == SDLK_F11)
+    toggleFullscreen();
 }
 
 bool Sdl::Context::poll()
 {
-  return SDL_PollEvent(&event_);
+  if(!SDL_PollEvent(&event_))
+    return false;
+
+  handleWindowEvent();
+  return true;
 }
 
 bool Sdl::Context::wait()
 {
-  return SDL_WaitEvent(&event_);
+  if(!SDL_WaitEvent(&event_))
+    return false;
+
+  handleWindowEvent();
+  return true;
+}
+
+bool Sdl::Context::waitTimeout(int ms)
+{
+  if(ms <= 0)
+    return poll();
+
+  if(!SDL_WaitEventTimeout(&event_, ms))
+    return false;
+
+  handleWindowEvent();
+  return true;
 }
 
@@ -2,6 +2,10 @@
 
 #include <SDL.h>
 #include <tuple>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
 #include "utils.hh"
 
 namespace Sdl
@@ -10,6 +14,8 @@ namespace Sdl
   {
     Uint8 r, g, b;
 
+    bool operator==(const Color &other) const = default;
+
     Color operator/(int d) const
     {
       auto tmp = *this;
@@ -68,15 +74,35 @@ namespace Sdl
   inline Color magenta  (Uint8 bri) { return {bri,   0, bri}; }
   inline Color cyan     (Uint8 bri) { return {  0, bri, bri}; }
 
+  struct DrawStats
+  {
+    int drawCalls;
+    int rects;
+    int stateCalls;
+    int stateCallsSkipped;
+  };
+
+  enum class Backend
+  {
+    Renderer,
+    Software,
+    Offscreen
+  };
+
   class Context
   {
   public:
+    using TextureKey = std::tuple<uint64_t, int, int>;
+
     Context() = default;
     ~Context();
     
-    void init(const char *title, int w, int h, int scale);
+    void init(const char *title, int w, int h, int scale, Backend backend = Backend::Renderer);
+
+    Backend backend() const { return backend_; }
+    bool hasTextures() const { return backend_ == Backend::Renderer; }
     
-    Color getColor();
+    Color getColor() { return color_; }
     void setColor(Color color);
 
     WithSetTmp<Context, Color> withColor(Color color)
@@ -92,17 +118,49 @@ namespace Sdl
       return WithSetTmp<Context, XY>(this, xy, &Context::getBaseXY, &Context::setBaseXY);
     }
 
+    SDL_BlendMode getBlendMode() { return blendMode_; }
+    void setBlendMode(SDL_BlendMode blendMode);
+
+    WithSetTmp<Context, SDL_BlendMode> withBlendMode(SDL_BlendMode blendMode)
+    {
+      return WithSetTmp<Context, SDL_BlendMode>(this, blendMode, &Context::getBlendMode, &Context::setBlendMode);
+    }
+
+    void setTextureColor(SDL_Texture *texture, Color color);
+
     void clear();
     void fillRect(int x, int y, int w, int h);
     void pixArtPut(int x, int y, int step, float frac = 1.);
 
+    void copy(SDL_Texture *texture, const SDL_Rect &src, const SDL_Rect &dst);
+
+    SDL_Texture *createTarget(int w, int h);
+    SDL_Texture *createTexture(int w, int h, const uint32_t *pixels);
+    void setTarget(SDL_Texture *target);
+
+    SDL_Texture *findTexture(const TextureKey &key) const;
+    void storeTexture(const TextureKey &key, SDL_Texture *texture);
+
+    void flush();
     void present();
+
+    // Window resizes re-show the last frame and F11 toggles fullscreen; both are
+    // handled inside poll()/wait()/waitTimeout() before the event is returned.
+    void toggleFullscreen();
+
+    const DrawStats &lastFrameStats() const { return lastFrameStats_; }
     
     bool poll();
     bool wait();
+    bool waitTimeout(int ms);
 
     const SDL_Event &event() const { return event_; }
     
+    const uint32_t *framebuffer() const { return framebuffer_.data(); }
+
+    void writeFrame(std::ostream &out);
+    void dumpFrames(std::string prefix) { dumpPrefix_ = std::move(prefix); }
+
     SDL_Window *window() { return window_; }
     SDL_Renderer *renderer() { return renderer_; }
 
@@ -110,10 +168,33 @@ namespace Sdl
     int hei() const { return hei_; }
 
   private:
+    bool usesFramebuffer() const { return backend_ != Backend::Renderer; }
+
+    void showFrame();
+    void handleWindowEvent();
+
     SDL_Window *window_ = nullptr; 
     SDL_Renderer *renderer_ = nullptr;
 
-    SDL_Event event_;
+    Backend backend_ = Backend::Renderer;
+    std::vector<uint32_t> framebuffer_;
+    SDL_Texture *frameTexture_ = nullptr;
+
+    std::string dumpPrefix_;
+    int numFrames_ = 0;
+
+    SDL_Event event_ = {};
+
+    Color color_ = {};
+    SDL_BlendMode blendMode_ = SDL_BLENDMODE_NONE;
+    SDL_Texture *target_ = nullptr;
+    std::map<SDL_Texture *, Color> textureColors_;
+    std::vector<SDL_Rect> batch_;
+
+    std::map<TextureKey, SDL_Texture *> textures_;
+    std::vector<SDL_Texture *> owned_;
+
+    DrawStats stats_ = {}, lastFrameStats_ = {};
 
     bool initialized_ = false;
     
@@ -1,151 +1,119 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
-#include <thread>
 #include <algorithm>
+#include <ranges>
+#include <filesystem>
 #include <functional>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 
+#include "engine.hh"
+#include "replay.hh"
 #include "sdlctx.hh"
 #include "font.hh"
 #include "fontutils.hh"
 #include "text.hh"
+#include "hud.hh"
 #include "common/args.hh"
+#include "common/str2num.hh"
+#include "font68.hh"
 
-static constexpr auto NSHAPES = 7;
-static constexpr auto NCOLORS = 6;
-static constexpr auto GAMEWID = 10;
-static constexpr auto GAMEHEI = 20;
 static constexpr auto CELLSIZE = 16;
 static constexpr auto NAMELIMIT = 12;
 static constexpr auto SCOREBOARDLIMIT = 18;
-static constexpr auto DIFFICULTYLIMIT = 10;
+static constexpr auto MAXCATCHUPTICKS = TICKRATE / 4;
+static constexpr auto CLEARTICKS = TICKRATE / 4;
+static constexpr auto KEYFRAMEINTERVAL = 10 * TICKRATE;
 
-struct Shape
-{
-  Shape(std::string_view input)
-  {
-    bool view[4][4];
-
-    for(int y = 0; y < 4; y++)
-      for(int x = 0; x < 4; x++)
-        view[y][x] = input[4*y + x] != ' ';
-
-    for(int v = 0; v < 4; v++)
-    {
-      int upmostY = 4, leftmostX = 4;
-
-      for(int y = 0; y < 4; y++)
-        for(int x = 0; x < 4; x++)
-          if(view[y][x])
-          {
-            if(y < upmostY)
-              upmostY = y;
-            if(x < leftmostX)
-              leftmostX = x;
-          }
-
-      memcpy(&views[v][0][0],
-             &view[upmostY][leftmostX],
-             &view[4][0] - &view[upmostY][leftmostX]);
-
-      for(int y = 0; y < 4; y++)
-        for(int x = 0; x < 4; x++)
-          view[3-x][y] = views[v][y][x];
-    }
-  }
-
-  bool views[4][4][4] = {};
-};
-
-static const std::array<Shape, NSHAPES> g_shapes
-{{
-  Shape("00  "
-        "00  "
-        "    "
-        "    "),
-
-  Shape("0   "
-        "0   "
-        "0   "
-        "0   "),
-
-  Shape("000 "
-        " 0  "
-        "    "
-        "    "),
-
-  Shape(" 00 "
-        "00  "
-        "    "
-        "    "),
-
-  Shape("00  "
-        " 00 "
-        "    "
-        "    "),
-
-  Shape("0   "
-        "000 "
-        "    "
-        "    "),
-
-  Shape("  0 "
-        "000 "
-        "    "
-        "    ")
-}};
+using Clock = std::chrono::steady_clock;
+using Tick = std::chrono::duration<int64_t, std::ratio<1, TICKRATE>>;
 
 class Game
 {
 public:
-  void init(int scale);
+  void init(const Args &args);
   void execute(bool help);
   bool finalize();
 
 private:
-  struct Falling
+  using Falling = Engine::Falling;
+
+  enum class Phase
   {
-    const Shape *shape;
-    int col, v, y, x;
+    Play,
+    Clear
   };
 
-  void spawn();
-  void moveLeft();
-  void moveRight();
-  void turn();
-  void skip();
-  void land();
-  void reduce();
-  bool collides();
-  const bool (*getShape(Falling &falling))[4];
+  void input(Input input);
+  void playReplayInputs();
+  void handleReplayKey(SDL_Keycode sym);
+  void seekReplay(int64_t tick);
 
   void showHelp();
   void promptDifficulty();
   void handleEvent(const SDL_Event &event);
   void loop();
   void render();
+  void createCellSprites();
+  SDL_Rect cellSprite(int colIdx, bool ghost) const;
+  template<class ForEachCell>
+  void renderCells(ForEachCell forEachCell);
+  SDL_Texture *updateBoardLayer();
   void renderTextInCenter(std::string_view text, int scale);
+  void renderHud();
   bool promptName();
   void showScoreboard();
   
-  void delay(int factor);
+  void runRealtime();
+  void runDueTicks();
+  int idleTicks() const;
+  void runHeadless();
+
+  void resyncClock();
+  Clock::time_point tickTime(int64_t tick) const;
 
 private:
   Sdl::Context sdl_;
   Font font_;
 
-  uint8_t cell_[GAMEHEI][GAMEWID];
+  Engine engine_;
+
+  Hud hud_;
+
+  SDL_Texture *cellSprites_ = nullptr;
+  SDL_Texture *boardLayer_ = nullptr;
+  bool boardLayerValid_;
 
-  Falling falling_, fallingNext_;
+  Phase phase_;
+  int phaseTicks_;
+  int clearScore_;
+  std::vector<Input> bufferedInputs_;
 
-  int difficulty_ = 0, clockPeriod_;
-  int clock_;
-  int score_;
+  int difficulty_ = 0;
 
+  Clock::time_point clockStart_;
+  int64_t clockTicks_;
+  int64_t wakeTick_;
+
+  std::optional<uint64_t> seed_;
+  Randomizer randomizer_;
+
+  std::optional<std::string> recordPath_;
+  std::string gameRecordPath_;
+  int numRecorded_ = 0;
+  int keyframeInterval_;
+  ReplayWriter replayWriter_;
+
+  std::optional<Replay> replay_;
+  size_t replayPos_;
+
+  bool headless_;
+  int frameEvery_;
+
+  bool skipAnimation_;
   bool started_;
   bool update_;
   bool pause_;
@@ -156,6 +124,21 @@ private:
 
 namespace
 {
+  Sdl::Color idx2col(int colIdx)
+  {
+    switch(colIdx)
+    {
+      case 1: return Sdl::RED;
+      case 2: return Sdl::BLUE;
+      case 3: return Sdl::GREEN;
+      case 4: return Sdl::YELLOW;
+      case 5: return Sdl::MAGENTA;
+      case 6: return Sdl::CYAN;
+
+      default: return Sdl::GRAY;
+    }
+  }
+
   bool isQuitEvent(const SDL_Event &event)
   {
     return event.type == SDL_QUIT
@@ -170,207 +153,298 @@ namespace
   }
 }
 
-void Game::init(int scale)
+void Game::init(const Args &args)
 {
-  sdl_.init("tetris", (GAMEWID + 1 + 4) * CELLSIZE, GAMEHEI * CELLSIZE, scale);
-  readFontFromFile(font_, "68.font");
-  srand(time(NULL));
+  skipAnimation_ = args.is("no-animation");
+
+  if(auto seed = args.getO("seed"))
+    seed_ = str2num<uint64_t>(*seed);
+
+  if(auto randomizer = parseRandomizer(args.getO("pieces").value_or("uniform")))
+    randomizer_ = *randomizer;
+  else
+    throw std::runtime_error("Unknown randomizer: " + args.getStr("pieces"));
+
+  recordPath_ = args.getStrO("record");
+  keyframeInterval_ = args.getIntO("keyframes").value_or(KEYFRAMEINTERVAL);
+
+  if(auto path = args.getO("play"))
+  {
+    auto in = std::ifstream(std::string(*path), std::ios::binary);
+    replay_.emplace();
+    replay_->load(in);
+  }
+
+  hud_.setVisible(args.is("hud"));
+
+  headless_ = args.is("headless");
+  frameEvery_ = std::max(1, args.getIntO("frame-every").value_or(1));
+
+  if(headless_ && !replay_)
+    throw std::runtime_error("Headless mode needs a replay to play");
+
+  currentName_ = args.getStrO("name").value_or("");
+
+  if(currentName_.size() > NAMELIMIT || !std::ranges::all_of(currentName_, [](char ch) { return isalpha(ch) || isdigit(ch); }))
+    throw std::runtime_error("Invalid player name: " + currentName_);
+
+  std::ranges::transform(currentName_, currentName_.begin(), [](char ch) { return char(toupper(ch)); });
+
+  sdl_.init("tetris",
+            (GAMEWID + 1 + 4) * CELLSIZE,
+            GAMEHEI * CELLSIZE,
+            args.getIntO("scale").value_or(1),
+            headless_              ? Sdl::Backend::Offscreen
+            : args.is("software")  ? Sdl::Backend::Software
+                                   : Sdl::Backend::Renderer);
+
+  if(auto prefix = args.getStrO("frames"))
+    sdl_.dumpFrames(*prefix);
+
+  if(auto path = args.getStrO("font"))
+    readFontFromFile(font_, *path);
+  else
+    font_.load(FONT68, sizeof(FONT68));
+
+  createCellSprites();
 }
 
 void Game::execute(bool help)
 {
-  clock_ = 0;
-  score_ = 0;
-
   started_ = false;
   update_ = true;
   pause_ = false;
   quit_ = false;
 
-  if(help)
+  if(help && !replay_)
     showHelp();
 
   if(quit_)
     return;
 
-  promptDifficulty();
+  if(replay_)
+    difficulty_ = replay_->header().difficulty;
+  else
+    promptDifficulty();
 
   if(quit_)
     return;
 
-  clockPeriod_ = DIFFICULTYLIMIT - difficulty_;
-
   started_ = true;
 
-  memset(cell_, 0, sizeof(cell_));
-  spawn();
-  spawn();
+  if(replay_)
+  {
+    replay_->start(engine_);
+    replayPos_ = 0;
+  }
+  else
+  {
+    engine_.start(seed_.value_or(time(NULL)), difficulty_, randomizer_);
+  }
 
-  while(true)
+  if(recordPath_)
   {
-    while(!quit_ && sdl_.poll())
-      handleEvent(sdl_.event());
-    
-    if(quit_)
-      break;
+    // Retries record next to the first game as NAME-2.EXT, NAME-3.EXT, ...
+    // instead of truncating it.
+    std::filesystem::path path = *recordPath_;
 
-    loop();
+    if(++numRecorded_ > 1)
+      path.replace_filename(path.stem().string() + "-" + std::to_string(numRecorded_) + path.extension().string());
+
+    gameRecordPath_ = path.string();
+
+    replayWriter_.open(gameRecordPath_, {.seed = engine_.seed(),
+                                         .difficulty = engine_.difficulty(),
+                                         .randomizer = engine_.randomizer(),
+                                         .keyframeInterval = keyframeInterval_});
+  }
+
+  phase_ = Phase::Play;
+  bufferedInputs_.clear();
+
+  if(headless_)
+    runHeadless();
+  else
+    runRealtime();
+
+  if(replayWriter_.isOpen() && !replayWriter_.close(engine_.ticks()))
+    std::cerr << "Failed to write replay " << gameRecordPath_ << '\n';
+}
+
+void Game::runRealtime()
+{
+  resyncClock();
 
+  while(!quit_)
+  {
     if(update_)
     {
+      auto frameStart = Clock::now();
+
       render();
+      if(pause_)
+        renderTextInCenter("PAUSE", 4);
+      if(hud_.visible())
+        renderHud();
       sdl_.present();
+
+      hud_.presented(SDL_GetTicks());
+      hud_.recordFrame(Clock::now() - frameStart);
+
       update_ = false;
     }
-    
-    delay(1);
-  }
-}
 
-bool Game::finalize()
-{
-  if(!started_ || sdl_.event().type == SDL_QUIT)
-    return true;
+    if(!pause_)
+      wakeTick_ = clockTicks_ + idleTicks();
 
-  if(promptName())
-    showScoreboard();
+    auto hasEvent = pause_
+                  ? sdl_.wait()
+                  : sdl_.waitTimeout(std::chrono::ceil<std::chrono::milliseconds>(tickTime(wakeTick_) - Clock::now()).count());
 
-  std::cout << "SCORE: " << score_ << '\n';
+    if(!pause_)
+      runDueTicks();
 
-  return !isRetryEvent(sdl_.event());
+    if(hasEvent && !quit_)
+      do handleEvent(sdl_.event()); while(!quit_ && sdl_.poll());
+  }
 }
 
-void Game::spawn()
+void Game::runDueTicks()
 {
-  auto r = rand();
-
-  falling_ = fallingNext_;
+  auto now = Clock::now();
 
-  fallingNext_.shape = &g_shapes[r % NSHAPES];
-  r /= NSHAPES;
+  for(int n = 0; !quit_ && tickTime(clockTicks_ + 1) <= now; )
+  {
+    // Ticks before wakeTick_ were known to be idle and slept through on
+    // purpose; only the ones after it mean the loop is falling behind.
+    bool late = clockTicks_ + 1 >= wakeTick_;
 
-  fallingNext_.col = 1 + r % NCOLORS;
-  r /= NCOLORS;
+    if(late && n++ == MAXCATCHUPTICKS)
+    {
+      resyncClock();
+      break;
+    }
 
-  fallingNext_.v = r  % 4;
-  r /= 4;
+    if(late)
+      hud_.recordTick(now - tickTime(clockTicks_ + 1));
 
-  fallingNext_.y = 0;
-  fallingNext_.x = 4;
-}
+    clockTicks_++;
+    loop();
 
-void Game::moveLeft()
-{
-  if(falling_.x > 0)
-  {
-    falling_.x--;
-    if(collides())
-      falling_.x++;
-  
-    update_ = true;
+    if(hud_.visible())
+      update_ = true;
   }
 }
 
-void Game::moveRight()
+int Game::idleTicks() const
 {
-  falling_.x++;
-  if(collides())
-    falling_.x--;
+  if(hud_.visible())
+    return 1;
 
-  update_ = true;
-}
+  if(phase_ == Phase::Clear)
+    return phaseTicks_;
 
-void Game::turn()
-{
-  falling_.v = (falling_.v + 1) % 4;
-  if(collides())
-    falling_.v = (falling_.v + 3) % 4;
-  
-  update_ = true;
-}
-
-void Game::skip()
-{
-  falling_.y++;
+  auto ticks = engine_.ticksUntilStep();
 
-  if(collides())
+  if(replay_)
   {
-    clock_ = 0;
-  }
-  else
-  {
-    do falling_.y++; while(!collides());
-    clock_ = 1;
-    
-    update_ = true;
+    auto &records = replay_->records();
+
+    if(replayPos_ == records.size())
+      return 1;
+
+    ticks = std::min<int64_t>(ticks, records[replayPos_].tick - engine_.ticks() + 1);
   }
 
-  falling_.y--;
+  return std::max(ticks, 1);
 }
 
-void Game::land()
+void Game::runHeadless()
 {
-  auto shape = getShape(falling_);
+  // Ticks run back to back without waiting on the clock, so the rendered
+  // frames depend only on the replay and can be compared against goldens.
+  clockTicks_ = 0;
 
-  for(int yRel = 0; yRel < 4; yRel++)
-    for(int xRel = 0; xRel < 4; xRel++)
-      if(shape[yRel][xRel])
-        cell_[falling_.y + yRel][falling_.x + xRel] = falling_.col;
-  
-  falling_.shape = nullptr;
+  int numFrames = 0;
+  Clock::duration renderTime = {};
+
+  while(!pause_ && !quit_)
+  {
+    clockTicks_++;
+    loop();
+
+    if(pause_ || clockTicks_ % frameEvery_ == 0)
+    {
+      auto start = Clock::now();
+      render();
+      if(hud_.visible())
+        renderHud();
+      sdl_.present();
+      hud_.recordFrame(Clock::now() - start);
+      renderTime += Clock::now() - start;
+      numFrames++;
+    }
+  }
+
+  std::cerr << "FRAMES: " << numFrames << '\n'
+            << "US/FRAME: " << std::chrono::duration_cast<std::chrono::microseconds>(renderTime).count() / std::max(numFrames, 1) << '\n';
 }
 
-void Game::reduce()
+bool Game::finalize()
 {
-  int numReduced = 0;
-
-  std::vector<int> fullRows;
-  fullRows.reserve(4);
+  if(!started_ || sdl_.event().type == SDL_QUIT)
+    return true;
 
-  for(int i = 0; i < GAMEHEI; i++)
-    if(std::all_of(&cell_[i][0], &cell_[i][GAMEWID], std::identity()))
-      fullRows.push_back(i);
+  if(replay_)
+  {
+    std::cout << "SCORE: " << engine_.score() << '\n';
 
-  if(fullRows.empty())
-    return;
+    if(headless_ && !currentName_.empty())
+      showScoreboard();
 
-  for(auto i : fullRows)
-    memset(cell_[i], 0, sizeof(cell_[i]));
+    return true;
+  }
 
-  auto dscore = fullRows.size() * fullRows.size() + difficulty_;
+  if(promptName())
+    showScoreboard();
 
-  score_ += dscore;
+  std::cout << "SEED: " << engine_.seed() << '\n'
+            << "SCORE: " << engine_.score() << '\n';
 
-  render();
-  renderTextInCenter("+" + std::to_string(dscore), 8);
-  sdl_.present();
-  delay(5);
+  if(recordPath_)
+    std::cout << "REPLAY: " << gameRecordPath_ << '\n';
 
-  for(auto i : fullRows)
-    memmove(cell_[1], cell_[0], (uint8_t *)cell_[i] - (uint8_t *)cell_);
-  
-  memset(cell_[0], 0, sizeof(cell_[0]));
+  return !isRetryEvent(sdl_.event());
 }
 
-bool Game::collides()
+void Game::input(Input input)
 {
-  auto shape = getShape(falling_);
+  if(phase_ != Phase::Play)
+  {
+    bufferedInputs_.push_back(input);
+    return;
+  }
 
-  for(int yRel = 0; yRel < 4; yRel++)
-    for(int xRel = 0; xRel < 4; xRel++)
-      if(shape[yRel][xRel])
-        if(auto y = falling_.y + yRel, x = falling_.x + xRel; y >= GAMEHEI || x >= GAMEWID || cell_[y][x])
-          return true;
+  if(replayWriter_.isOpen())
+    replayWriter_.record(engine_.ticks(), input);
 
-  return false;
+  if(engine_.input(input))
+    update_ = true;
 }
 
-const bool (*Game::getShape(Falling &falling))[4]
+void Game::playReplayInputs()
 {
-  if(falling.shape)
-    return falling.shape->views[falling.v];
-  else
-    return nullptr;
+  auto &records = replay_->records();
+
+  while(replayPos_ < records.size() && records[replayPos_].tick <= engine_.ticks())
+    if(engine_.input(records[replayPos_++].input))
+      update_ = true;
+
+  if(replayPos_ == records.size() || engine_.over())
+  {
+    pause_ = true;
+    update_ = true;
+  }
 }
 
 void Game::showHelp()
@@ -481,126 +555,330 @@ void Game::handleEvent(const SDL_Event &event)
     return;
   }
 
+  if(event.type == SDL_RENDER_TARGETS_RESET)
+  {
+    boardLayerValid_ = false;
+    update_ = true;
+    return;
+  }
+
+  if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3)
+  {
+    hud_.toggle();
+    update_ = true;
+    return;
+  }
+
+  if(event.type == SDL_KEYDOWN)
+    hud_.recordInput(event.key.timestamp);
+
+  if(event.type == SDL_KEYDOWN && replay_ && event.key.keysym.sym != SDLK_SPACE)
+  {
+    handleReplayKey(event.key.keysym.sym);
+    return;
+  }
+
   if(event.type == SDL_KEYDOWN)
   {
     switch(event.key.keysym.sym)
     {
       case SDLK_LEFT:
         if(!pause_)
-          moveLeft();
+          input(Input::Left);
       break;
 
       case SDLK_RIGHT:
         if(!pause_)
-          moveRight();
+          input(Input::Right);
       break;
 
       case SDLK_UP:
         if(!pause_)
-          turn();
+          input(Input::Turn);
       break;
 
       case SDLK_DOWN:
         if(!pause_)
-          skip();
+          input(Input::Skip);
       break;
       
       case SDLK_SPACE:
-        if((pause_ = !pause_))
-        {
-          renderTextInCenter("PAUSE", 4);
-          sdl_.present();
+        if(!(pause_ = !pause_))
+          resyncClock();
 
-          while(pause_ && !quit_)
-          {
-            sdl_.wait();
-            handleEvent(sdl_.event());
-          }
-        }
+        update_ = true;
       break;
     }
   }
 }
 
+void Game::handleReplayKey(SDL_Keycode sym)
+{
+  auto tick = int64_t(engine_.ticks());
+
+  switch(sym)
+  {
+    case SDLK_LEFT: seekReplay(tick - TICKRATE); break;
+    case SDLK_RIGHT: seekReplay(tick + TICKRATE); break;
+    case SDLK_DOWN: seekReplay(tick - 10 * TICKRATE); break;
+    case SDLK_UP: seekReplay(tick + 10 * TICKRATE); break;
+    case SDLK_HOME: seekReplay(0); break;
+    case SDLK_END: seekReplay(replay_->endTick()); break;
+
+    case SDLK_COMMA:
+      pause_ = true;
+      seekReplay(tick - 1);
+    break;
+
+    case SDLK_PERIOD:
+      pause_ = true;
+      seekReplay(tick + 1);
+    break;
+  }
+}
+
+void Game::seekReplay(int64_t tick)
+{
+  replay_->seek(engine_, replayPos_, std::clamp<int64_t>(tick, 0, replay_->endTick()));
+
+  phase_ = Phase::Play;
+  bufferedInputs_.clear();
+
+  update_ = true;
+  resyncClock();
+}
+
 void Game::loop()
 {
-  clock_ = (clock_ + 1) % clockPeriod_;
+  switch(phase_)
+  {
+    case Phase::Play:
+      if(replay_)
+      {
+        playReplayInputs();
+
+        if(pause_)
+          return;
+      }
+
+      if(engine_.tick())
+        update_ = true;
+
+      if(replayWriter_.isOpen())
+        replayWriter_.checkpoint(engine_);
+
+      if(auto dscore = engine_.cleared().dscore; dscore && !skipAnimation_)
+      {
+        phase_ = Phase::Clear;
+        phaseTicks_ = CLEARTICKS;
+        clearScore_ = dscore;
+        return;
+      }
+    break;
 
-  if(clock_ == 0)
+    case Phase::Clear:
+      if(--phaseTicks_ > 0)
+        return;
+
+      phase_ = Phase::Play;
+      update_ = true;
+
+      for(auto bufferedInput : bufferedInputs_)
+        input(bufferedInput);
+
+      bufferedInputs_.clear();
+    break;
+  }
+
+  if(engine_.over() && !replay_)
+    quit_ = true;
+}
+
+void Game::createCellSprites()
+{
+  constexpr int spritesW = (NCOLORS + 1) * CELLSIZE;
+  constexpr int spritesH = 2 * CELLSIZE;
+
+  std::vector<uint32_t> pixels(spritesW * spritesH, 0x000000ff);
+
+  auto putSquare = [&](int spriteX, int spriteY, float frac, Sdl::Color color)
   {
-    falling_.y++;
-    if(collides())
-    {
-      falling_.y--;
-      land();
-      reduce();
-      spawn();
-      if(collides())
-        quit_ = true;
-    }
-    
-    update_ = true;
+    int size = frac * CELLSIZE;
+    int offset = (CELLSIZE - size) / 2;
+    uint32_t rgba = color.r << 24 | color.g << 16 | color.b << 8 | 0xff;
+
+    for(int y = 0; y < size; y++)
+      std::fill_n(&pixels[(spriteY + offset + y) * spritesW + spriteX + offset], size, rgba);
+  };
+
+  for(int colIdx = 1; colIdx <= NCOLORS; colIdx++)
+  {
+    auto [x, y, w, h] = cellSprite(colIdx, false);
+    putSquare(x, y, 0.875, idx2col(colIdx) / 2);
+    putSquare(x, y, 0.750, idx2col(colIdx));
+
+    auto [ghostX, ghostY, ghostW, ghostH] = cellSprite(colIdx, true);
+    putSquare(ghostX, ghostY, 0.875, idx2col(colIdx) / 4);
   }
+
+  cellSprites_ = sdl_.createTexture(spritesW, spritesH, pixels.data());
 }
 
-void Game::render()
+SDL_Rect Game::cellSprite(int colIdx, bool ghost) const
 {
-  sdl_.setColor(Sdl::BLACK);
-  sdl_.clear();
+  return {colIdx * CELLSIZE, ghost * CELLSIZE, CELLSIZE, CELLSIZE};
+}
 
-  auto idx2col = [](int colIdx) -> Sdl::Color
+template<class ForEachCell>
+void Game::renderCells(ForEachCell forEachCell)
+{
+  if(cellSprites_)
   {
-    switch(colIdx)
+    forEachCell([&](int x, int y, int col)
     {
-      case 1: return Sdl::RED;
-      case 2: return Sdl::BLUE;
-      case 3: return Sdl::GREEN;
-      case 4: return Sdl::YELLOW;
-      case 5: return Sdl::MAGENTA;
-      case 6: return Sdl::CYAN;
+      sdl_.copy(cellSprites_, cellSprite(col, false), {x * CELLSIZE, y * CELLSIZE, CELLSIZE, CELLSIZE});
+    });
+    return;
+  }
 
-      default: return Sdl::GRAY;
+  for(auto [shade, frac] : {std::pair{2, 0.875f}, std::pair{1, 0.750f}})
+    for(int colIdx = 1; colIdx <= NCOLORS; colIdx++)
+    {
+      sdl_.setColor(idx2col(colIdx) / shade);
+      forEachCell([&](int x, int y, int col)
+      {
+        if(col == colIdx)
+          sdl_.pixArtPut(x, y, CELLSIZE, frac);
+      });
     }
-  };
+}
 
-  auto renderCell = [&](int x, int y, int colIdx)
+SDL_Texture *Game::updateBoardLayer()
+{
+  if(!boardLayer_)
   {
-    auto col = idx2col(colIdx);
+    boardLayer_ = sdl_.createTarget(CELLSIZE * GAMEWID, CELLSIZE * GAMEHEI);
+    boardLayerValid_ = false;
 
-    sdl_.setColor(col / 2);
-    sdl_.pixArtPut(x, y, CELLSIZE, 0.875);
+    if(!boardLayer_)
+      return nullptr;
+  }
 
-    sdl_.setColor(col);
-    sdl_.pixArtPut(x, y, CELLSIZE, 0.750);
+  auto isDirty = [&](int x, int y)
+  {
+    return !boardLayerValid_ || engine_.dirty(y) & (1 << x);
   };
 
-  auto renderFalling = [&](Falling &falling, int x, int y)
+  if(boardLayerValid_ && std::ranges::none_of(std::views::iota(0, GAMEHEI), [&](int y) { return engine_.dirty(y); }))
+    return boardLayer_;
+
+  sdl_.setTarget(boardLayer_);
+  sdl_.setColor(Sdl::BLACK);
+
+  if(!boardLayerValid_)
+    sdl_.clear();
+  else
+    for(int y = 0; y < GAMEHEI; y++)
+      for(int x = 0; x < GAMEWID; x++)
+        if(isDirty(x, y))
+          sdl_.pixArtPut(x, y, CELLSIZE);
+
+  renderCells([&](auto renderCell)
+  {
+    for(int y = 0; y < GAMEHEI; y++)
+      for(int x = 0; x < GAMEWID; x++)
+        if(auto col = engine_.cell(y, x); col && isDirty(x, y))
+          renderCell(x, y, col);
+  });
+
+  sdl_.setTarget(nullptr);
+
+  engine_.clearDirty();
+  boardLayerValid_ = true;
+
+  return boardLayer_;
+}
+
+void Game::render()
+{
+  auto boardLayer = updateBoardLayer();
+
+  sdl_.setColor(Sdl::BLACK);
+  sdl_.clear();
+
+  auto forEachFallingCell = [&](const Falling &falling, int x, int y, auto renderCell)
   {
-    if(auto shape = getShape(falling))
+    if(auto shape = Engine::getShape(falling))
       for(int yRel = 0; yRel < 4; yRel++)
         for(int xRel = 0; xRel < 4; xRel++)
           if(shape[yRel][xRel])
             renderCell(x + xRel, y + yRel, falling.col);
   };
 
-  for(int y = 0; y < GAMEHEI; y++)
-    for(int x = 0; x < GAMEWID; x++)
-      if(auto col = cell_[y][x])
-        renderCell(x, y, col);
+  auto &falling = engine_.falling();
+
+  if(boardLayer)
+  {
+    auto boardRect = SDL_Rect{0, 0, CELLSIZE * GAMEWID, CELLSIZE * GAMEHEI};
+    sdl_.copy(boardLayer, boardRect, boardRect);
+  }
+
+  if(falling.shape)
+  {
+    auto ghost = engine_.ghost();
+
+    sdl_.setColor(idx2col(ghost.col) / 4);
+    forEachFallingCell(ghost, ghost.x, ghost.y, [&](int x, int y, int col)
+    {
+      if(cellSprites_)
+        sdl_.copy(cellSprites_, cellSprite(col, true), {x * CELLSIZE, y * CELLSIZE, CELLSIZE, CELLSIZE});
+      else
+        sdl_.pixArtPut(x, y, CELLSIZE, 0.875);
+    });
+  }
+
+  renderCells([&](auto renderCell)
+  {
+    if(!boardLayer)
+      for(int y = 0; y < GAMEHEI; y++)
+        for(int x = 0; x < GAMEWID; x++)
+          if(auto col = engine_.cell(y, x))
+            renderCell(x, y, col);
+
+    forEachFallingCell(falling, falling.x, falling.y, renderCell);
+    forEachFallingCell(engine_.fallingNext(), GAMEWID + 1, 0, renderCell);
+  });
 
   sdl_.withColor(Sdl::GRAY)
       ->withBaseXY({CELLSIZE * GAMEWID, 0})
       ->fillRect(0, 0, CELLSIZE / 2, CELLSIZE * GAMEHEI);
-
-  renderFalling(falling_, falling_.x, falling_.y);
-  renderFalling(fallingNext_, GAMEWID + 1, 0);
   
   sdl_.setColor(Sdl::WHITE);
-  renderTextAt(std::to_string(score_), {.sdl = sdl_,
+  renderTextAt(std::to_string(engine_.score()), {.sdl = sdl_,
                                         .font = font_,
                                         .scale = 2}, {.pos = {sdl_.wid() - 3, sdl_.hei() - 4},
                                                       .hAlign = HAlign::Right,
                                                       .vAlign = VAlign::Down});
+
+  if(phase_ == Phase::Clear)
+    renderTextInCenter("+" + std::to_string(clearScore_), 8);
+
+  if(replay_)
+  {
+    auto seconds = engine_.ticks() / TICKRATE;
+    auto minutesStr = std::to_string(seconds / 60);
+    auto secondsStr = std::to_string(seconds % 60);
+
+    sdl_.setColor(Sdl::gray(128));
+    renderTextAt(minutesStr + (secondsStr.size() < 2 ? ":0" : ":") + secondsStr, {.sdl = sdl_,
+                                                                                   .font = font_}, {.pos = {2, 2}});
+  }
+}
+
+void Game::renderHud()
+{
+  auto gravityPeriodMs = 1000. * ONEROW / (engine_.gravity() * TICKRATE);
+  hud_.render(sdl_, font_, gravityPeriodMs);
 }
 
 void Game::renderTextInCenter(std::string_view text, int scale)
@@ -792,15 +1070,23 @@ void Game::showScoreboard()
     .hAlign = HAlign::Right,
     .vAlign = VAlign::Down};
 
-  auto scoreboard = readScoreboardFromFile("scoreboard");
-  
-  auto out = std::ofstream("scoreboard", std::ios::trunc);
+  // Headless runs start from an empty scoreboard and leave the file alone, so
+  // the dumped frame depends only on the replay and the name.
+  auto scoreboard = headless_ ? Scoreboard() : readScoreboardFromFile("scoreboard");
   
   auto currentNameFixed = !currentName_.empty()
                         ? std::string_view(currentName_)
                         : std::string_view("-");
 
-  insertToScoreboard(scoreboard, currentNameFixed, score_);
+  insertToScoreboard(scoreboard, currentNameFixed, engine_.score());
+
+  if(!headless_)
+  {
+    auto out = std::ofstream("scoreboard", std::ios::trunc);
+
+    for(const auto &[name, score] : scoreboard)
+      out << name << ' ' << score << '\n';
+  }
 
   sdl_.setColor(Sdl::BLACK);
   sdl_.clear();
@@ -809,8 +1095,6 @@ void Game::showScoreboard()
   {
     const auto &[name, score] = scoreboard[i];
 
-    out << name << ' ' << score << '\n';
-
     sdl_.setColor((name == currentNameFixed) ? Sdl::gray(192) : Sdl::gray(128));
 
     trp.skipRows = i;
@@ -822,24 +1106,63 @@ void Game::showScoreboard()
 
   trp.skipRows = 0;
   renderTextAt(currentNameFixed, trp, tppYourName);
-  renderTextAt(std::to_string(score_), trp, tppYourScore);
+  renderTextAt(std::to_string(engine_.score()), trp, tppYourScore);
 
   sdl_.present();
-  
-  while(sdl_.wait(), sdl_.event().type != SDL_QUIT && sdl_.event().type != SDL_KEYDOWN);
+
+  if(!headless_)
+    while(sdl_.wait(), sdl_.event().type != SDL_QUIT && sdl_.event().type != SDL_KEYDOWN);
 }
 
-void Game::delay(int factor)
+void Game::resyncClock()
 {
-  std::this_thread::sleep_for(std::chrono::milliseconds(factor * 50));
+  clockStart_ = Clock::now();
+  clockTicks_ = 0;
+  wakeTick_ = 0;
+}
+
+Clock::time_point Game::tickTime(int64_t tick) const
+{
+  return clockStart_ + std::chrono::duration_cast<Clock::duration>(Tick(tick));
 }
 
 int main(int argc, char **argv)
 {
-  Args args(argc, argv, {{"s", "scale"}}, {{"h", "help"}});
+  Args args(argc, argv, {{"s", "scale"},
+                         {"r", "seed"},
+                         {"p", "pieces"},
+                         {"o", "record"},
+                         {"k", "keyframes"},
+                         {"i", "play"},
+                         {"t", "font"},
+                         {"F", "frames"},
+                         {"E", "frame-every"},
+                         {"N", "name"}}, {{"h", "help"},
+                                          {"n", "no-animation"},
+                                          {"f", "fast"},
+                                          {"S", "software"},
+                                          {"H", "headless"},
+                                          {"D", "hud"}});
+
+  if(args.is("fast"))
+  {
+    auto in = std::ifstream(args.getStr("play"), std::ios::binary);
+
+    Replay replay;
+    replay.load(in);
+
+    Engine engine;
+    replay.play(engine);
+
+    std::cout << "SEED: " << engine.seed() << '\n'
+              << "SCORE: " << engine.score() << '\n'
+              << "TICKS: " << engine.ticks() << '\n';
+
+    return 0;
+  }
 
   Game game;
-  game.init(args.getIntO("scale").value_or(1));
+  game.init(args);
 
   game.execute(args.is("help"));
 
@@ -0,0 +1,83 @@
+#include "engine.hh"
+#include "replay.hh"
+#include "common/args.hh"
+#include "common/rng.hh"
+#include "common/str2num.hh"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <span>
+#include <stdexcept>
+
+int main(int argc, char **argv)
+{
+  Args args(argc, argv, {{"n", "games"},
+                         {"r", "seed"},
+                         {"d", "difficulty"},
+                         {"p", "pieces"},
+                         {"t", "ticks"}}, {{"q", "quiet"}});
+
+  auto games = args.getIntO("games").value_or(1);
+  auto seed = str2num<uint64_t>(args.getO("seed").value_or("0"));
+  auto difficulty = args.getIntO("difficulty").value_or(0);
+  auto randomizer = parseRandomizer(args.getO("pieces").value_or("uniform"));
+  auto tickLimit = args.getIntO("ticks").value_or(100000);
+  auto replayPaths = std::span(args.targets()).subspan(1);
+
+  if(!randomizer)
+    throw std::runtime_error("Unknown randomizer: " + args.getStr("pieces"));
+
+  Engine engine;
+  uint64_t totalTicks = 0;
+
+  auto report = [&](const auto &name)
+  {
+    totalTicks += engine.ticks();
+
+    if(!args.is("quiet"))
+      std::cout << name << ' ' << engine.score() << ' ' << engine.ticks() << '\n';
+  };
+
+  auto startTime = std::chrono::steady_clock::now();
+
+  if(!replayPaths.empty())
+  {
+    games = replayPaths.size();
+
+    for(auto path : replayPaths)
+    {
+      auto in = std::ifstream(std::string(path), std::ios::binary);
+
+      Replay replay;
+      replay.load(in);
+      replay.play(engine);
+
+      report(path);
+    }
+  }
+  else
+  {
+    for(int game = 0; game < games; ++game)
+    {
+      auto gameSeed = seed + game;
+
+      Rng inputs(~gameSeed);
+
+      engine.start(gameSeed, difficulty, *randomizer);
+
+      while(!engine.over() && engine.ticks() < tickLimit)
+      {
+        auto r = inputs.below(20);
+        engine.step(r <= int(Input::Skip) ? Input(r) : Input::None);
+      }
+
+      report(gameSeed);
+    }
+  }
+
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+  std::cerr << "GAMES: " << games << '\n'
+            << "TICKS: " << totalTicks << '\n'
+            << "TICKS/S: " << uint64_t(totalTicks / seconds) << '\n';
+}
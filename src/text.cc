@@ -1,24 +1,128 @@
 #include "text.hh"
+#include <algorithm>
+#include <bit>
+#include <vector>
 #include <cctype>
 
+namespace
+{
+  constexpr int ATLASCOLS = 16;
+  constexpr int ATLASCHARS = 256;  // text is drawn byte-wise, so up to Latin-1
+  constexpr int ATLASROWS = ATLASCHARS / ATLASCOLS;
+
+  struct GlyphLayout
+  {
+    int step, size, offset;
+    int cellW, cellH;
+  };
+
+  GlyphLayout getGlyphLayout(const TextRenderParams &p)
+  {
+    GlyphLayout l;
+
+    l.step = p.scale;
+    l.size = (1. + p.pixelOverlap) * p.scale;
+    l.offset = (l.step - l.size) / 2;
+    l.cellW = (p.font.wid() - 1) * l.step + l.size;
+    l.cellH = (p.font.hei() - 1) * l.step + l.size;
+
+    return l;
+  }
+
+  SDL_Texture *getGlyphAtlas(const TextRenderParams &p, const GlyphLayout &l)
+  {
+    auto key = Sdl::Context::TextureKey{p.font.id(), p.scale, int(p.pixelOverlap * 256)};
+
+    if(auto atlas = p.sdl.findTexture(key))
+      return atlas;
+
+    if(l.size <= 0 || !p.sdl.hasTextures())
+      return nullptr;
+
+    auto atlasW = ATLASCOLS * l.cellW;
+    auto atlasH = ATLASROWS * l.cellH;
+
+    std::vector<uint32_t> pixels(atlasW * atlasH, 0);
+
+    for(int c = 0; c < ATLASCHARS; ++c)
+    {
+      if(!p.font.has(c))
+        continue;
+
+      auto cellX = c % ATLASCOLS * l.cellW;
+      auto cellY = c / ATLASCOLS * l.cellH;
+
+      for(int y = 0; y < p.font.hei(); ++y)
+        for(auto bits = p.font.row(c, y); bits; bits &= bits - 1)
+        {
+          int x = std::countr_zero(bits);
+
+          for(int py = 0; py < l.size; ++py)
+            std::fill_n(&pixels[(cellY + y * l.step + py) * atlasW + cellX + x * l.step], l.size, 0xffffffff);
+        }
+    }
+
+    auto atlas = SDL_CreateTexture(p.sdl.renderer(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, atlasW, atlasH);
+
+    if(!atlas)
+      return nullptr;
+
+    SDL_UpdateTexture(atlas, nullptr, pixels.data(), atlasW * sizeof(uint32_t));
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+
+    p.sdl.storeTexture(key, atlas);
+
+    return atlas;
+  }
+
+  void renderTextRects(std::string_view text, TextRenderParams p)
+  {
+    auto l = getGlyphLayout(p);
+    int row = p.skipRows, col = p.skipCols;
+
+    for(uint8_t c : text)
+    {
+      if(c != '\n')
+      {
+        if(p.font.has(c))
+          for(auto [x, y, w, h] : p.font.rects(c))
+            p.sdl.fillRect((p.font.wid()*col + x) * l.step + l.offset,
+                           (p.font.hei()*row + y) * l.step + l.offset,
+                           (w - 1) * l.step + l.size,
+                           (h - 1) * l.step + l.size);
+
+        col += 1;
+      }
+      else
+      {
+        row += 1;
+        col = p.skipCols;
+      }
+    }
+  }
+}
+
 void renderText(std::string_view text, TextRenderParams p)
 {
+  auto l = getGlyphLayout(p);
+  auto atlas = getGlyphAtlas(p, l);
+
+  if(!atlas)
+    return renderTextRects(text, p);
+
+  p.sdl.setTextureColor(atlas, p.sdl.getColor());
+
   int row = p.skipRows, col = p.skipCols;
 
-  for(auto c : text)
+  for(uint8_t c : text)
   {
     if(c != '\n')
     {
-      auto fontElem = p.font[c];
-
-      for(int x = 0; x < p.font.wid(); ++x)
-        for(int y = 0; y < p.font.hei(); ++y)
-          if(fontElem[x][y])
-            p.sdl.pixArtPut(p.font.wid()*col + x,
-                            p.font.hei()*row + y,
-                            p.scale,
-                            1. + p.pixelOverlap);
-            
+      if(!p.font.isEmpty(c))
+        p.sdl.copy(atlas,
+                   {c % ATLASCOLS * l.cellW, c / ATLASCOLS * l.cellH, l.cellW, l.cellH},
+                   {p.font.wid() * col * l.step + l.offset, p.font.hei() * row * l.step + l.offset, l.cellW, l.cellH});
+
       col += 1;
     }
     else